@@ -0,0 +1,99 @@
+// Micro-benchmarks of sjtu::int2048 multiply, divide and to_string.
+//
+// Each case is calibrated to run for about TARGET_SECONDS per sample, run
+// once to warm up, then sampled --samples times; the median time per
+// operation is reported. Results are printed as JSON lines, one per case:
+//   {"name": "int2048/multiply/1000", "digits": 1000, "ns_per_op": ..., ...}
+#include "ThreadPool.h"
+#include "int2048.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const double TARGET_SECONDS = 0.05;
+
+// A number with the given count of pseudo-random decimal digits.
+static sjtu::int2048 makeNumber(size_t digits, unsigned seed) {
+  std::string text(digits, '0');
+  unsigned state = seed * 2654435761u + 1;
+  for (size_t i = 0; i < digits; ++i) {
+    state = state * 1103515245u + 12345u;
+    text[i] = '0' + (state >> 16) % 10;
+  }
+  text[0] = '1' + text[0] % 9;
+  return sjtu::int2048(text);
+}
+
+// Keeps results alive so the compiler cannot drop the measured work.
+static volatile size_t sink;
+
+static double secondsFor(const std::function<void()> &operation, long iterations) {
+  auto start = Clock::now();
+  for (long i = 0; i < iterations; ++i) operation();
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void run(const std::string &name, size_t digits, int samples, const std::function<void()> &operation) {
+  // warm up, and find how many iterations make one sample
+  long iterations = 1;
+  double elapsed = secondsFor(operation, iterations);
+  while (elapsed < TARGET_SECONDS && iterations < (1L << 30)) {
+    iterations *= elapsed > 0 ? std::min(100.0, std::max(2.0, 1.2 * TARGET_SECONDS / elapsed)) : 100.0;
+    elapsed = secondsFor(operation, iterations);
+  }
+  std::vector<double> perOp;
+  for (int i = 0; i < samples; ++i) {
+    perOp.push_back(secondsFor(operation, iterations) * 1e9 / iterations);
+  }
+  std::sort(perOp.begin(), perOp.end());
+  double median = perOp[perOp.size() / 2];
+  if (perOp.size() % 2 == 0) median = (median + perOp[perOp.size() / 2 - 1]) / 2;
+  std::cout << "{\"name\": \"int2048/" << name << "/" << digits << "\", \"digits\": " << digits
+            << ", \"ns_per_op\": " << median << ", \"min_ns\": " << perOp.front() << ", \"max_ns\": " << perOp.back()
+            << ", \"iterations\": " << iterations << ", \"samples\": " << samples << "}" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  int samples = 5;
+  std::vector<size_t> sizes = {16, 256, 4096, 16384};
+  // division is quadratic in this implementation; larger sizes take seconds per operation
+  const size_t maxDivideDigits = 4096;
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--samples=", 10) == 0 && atoi(argv[i] + 10) > 0) {
+      samples = atoi(argv[i] + 10);
+    } else if (strcmp(argv[i], "--quick") == 0) {
+      sizes = {16, 256, 4096};
+    } else if (strncmp(argv[i], "--threads=", 10) == 0 && atoi(argv[i] + 10) > 0) {
+      ThreadPool::shared().setThreads(atoi(argv[i] + 10));
+    } else {
+      std::cerr << "usage: " << argv[0] << " [--samples=N] [--quick] [--threads=N]" << std::endl;
+      return 2;
+    }
+  }
+
+  std::cout << std::fixed << std::setprecision(1);
+  for (size_t digits : sizes) {
+    sjtu::int2048 a = makeNumber(digits, 1), b = makeNumber(digits, 2);
+    run("multiply", digits, samples, [&]() { sink = (a * b).s.size(); });
+  }
+  for (size_t digits : sizes) {
+    if (digits > maxDivideDigits) continue;
+    // a 2n-digit number by an n-digit one, the shape of schoolbook and
+    // Newton division's worst case
+    sjtu::int2048 a = makeNumber(2 * digits, 3), b = makeNumber(digits, 4);
+    run("divide", digits, samples, [&]() { sink = (a / b).s.size(); });
+  }
+  for (size_t digits : sizes) {
+    sjtu::int2048 a = makeNumber(digits, 5);
+    run("to_string", digits, samples, [&]() { sink = a.to_string().size(); });
+  }
+  return 0;
+}
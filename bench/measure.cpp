@@ -0,0 +1,129 @@
+// Run one command and report what it cost, as a single JSON line:
+//   {"status": 0, "wall_s": 0.0123, "max_rss_kb": 5120, "instructions": 12345678}
+//
+// usage: measure [--stdin=FILE] [--stdout=FILE] [--timeout=SECONDS] -- command args...
+//
+// Instructions are counted in user space with perf_event_open, for the
+// command and anything it starts; if the kernel does not allow that,
+// "instructions" is null. Peak RSS comes from wait4. A command killed by a
+// signal (or by the timeout) reports status 128 + the signal number.
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static int openInstructionCounter(pid_t pid) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+  attr.disabled = 1;
+  attr.enable_on_exec = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [--stdin=FILE] [--stdout=FILE] [--timeout=SECONDS] -- command args...\n", prog);
+  exit(2);
+}
+
+static pid_t child = 0;
+
+static void onAlarm(int) {
+  if (child > 0) kill(child, SIGKILL);
+}
+
+int main(int argc, char *argv[]) {
+  const char *input = nullptr, *output = nullptr;
+  int timeout = 0;
+  int i = 1;
+  for (; i < argc; ++i) {
+    if (strncmp(argv[i], "--stdin=", 8) == 0) {
+      input = argv[i] + 8;
+    } else if (strncmp(argv[i], "--stdout=", 9) == 0) {
+      output = argv[i] + 9;
+    } else if (strncmp(argv[i], "--timeout=", 10) == 0) {
+      timeout = atoi(argv[i] + 10);
+    } else if (strcmp(argv[i], "--") == 0) {
+      ++i;
+      break;
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (i >= argc) usage(argv[0]);
+
+  // the child waits for this pipe to close, so the counter is attached
+  // before it execs
+  int ready[2];
+  if (pipe(ready) != 0) {
+    perror("pipe");
+    return 2;
+  }
+  auto start = std::chrono::steady_clock::now();
+  child = fork();
+  if (child < 0) {
+    perror("fork");
+    return 2;
+  }
+  if (child == 0) {
+    close(ready[1]);
+    char byte;
+    while (read(ready[0], &byte, 1) < 0 && errno == EINTR) {}
+    close(ready[0]);
+    if (input) {
+      int fd = open(input, O_RDONLY);
+      if (fd < 0 || dup2(fd, 0) < 0) _exit(127);
+      close(fd);
+    }
+    if (output) {
+      int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0 || dup2(fd, 1) < 0) _exit(127);
+      close(fd);
+    }
+    execvp(argv[i], argv + i);
+    _exit(127);
+  }
+  close(ready[0]);
+  int counter = openInstructionCounter(child);
+  close(ready[1]);
+
+  if (timeout > 0) {
+    signal(SIGALRM, onAlarm);
+    alarm(timeout);
+  }
+  int status = 0;
+  struct rusage usage;
+  while (wait4(child, &status, 0, &usage) < 0) {
+    if (errno != EINTR) {
+      perror("wait4");
+      return 2;
+    }
+  }
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  alarm(0);
+
+  int code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+  printf("{\"status\": %d, \"wall_s\": %.6f, \"max_rss_kb\": %ld, \"instructions\": ", code, wall, usage.ru_maxrss);
+  uint64_t instructions;
+  if (counter >= 0 && read(counter, &instructions, sizeof(instructions)) == sizeof(instructions)) {
+    printf("%llu}\n", (unsigned long long)instructions);
+  } else {
+    printf("null}\n");
+  }
+  return 0;
+}
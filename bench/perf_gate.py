@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""Check the testcases for correctness and performance regressions.
+
+Every testcases/*/*.in is run --runs times through the measure helper
+(bench/measure.cpp), which reports wall time, peak RSS and, when the kernel
+allows perf_event_open, user-space instruction counts. Every run's output
+must match the .out file, and no run may be killed.
+
+With --baseline, each case's median is compared against the stored one. A
+case regresses when its cost grows by more than --threshold (a fraction;
+0.25 is 25%). The cost is the instruction count when both sides have one,
+since it hardly varies between runs, and wall time otherwise, ignoring
+growth below --min-wall-delta seconds, which is noise. Peak RSS is gated
+separately by --rss-threshold. --write-baseline stores this run's results
+for later comparisons.
+
+Exits with status 1 if any case fails or regresses.
+Usually run through the build: cmake --build build --target perf-gate
+"""
+import argparse
+import json
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def find_cases(directories):
+    cases = []
+    for directory in directories:
+        for name in sorted(os.listdir(directory)):
+            if name.endswith(".in") and os.path.exists(os.path.join(directory, name[:-3] + ".out")):
+                cases.append(os.path.join(directory, name[:-3]))
+    return cases
+
+
+def case_name(path):
+    return os.path.join(os.path.basename(os.path.dirname(path)), os.path.basename(path))
+
+
+def measure(args, case, output):
+    command = [args.measure, "--stdin=" + case + ".in", "--stdout=" + output, "--timeout=%d" % args.timeout,
+               "--", args.interpreter] + args.interpreter_arg
+    result = subprocess.run(command, stdout=subprocess.PIPE, text=True, check=True)
+    return json.loads(result.stdout)
+
+
+def run_case(args, case, scratch):
+    with open(case + ".out", "rb") as f:
+        expected = f.read()
+    runs = []
+    for _ in range(args.runs):
+        run = measure(args, case, scratch)
+        with open(scratch, "rb") as f:
+            # scripts that end in a runtime error exit with status 1 on purpose
+            run["correct"] = run["status"] < 128 and f.read() == expected
+        runs.append(run)
+    instructions = [run["instructions"] for run in runs]
+    return {
+        "correct": all(run["correct"] for run in runs),
+        "status": max(run["status"] for run in runs),
+        "wall_s": statistics.median(run["wall_s"] for run in runs),
+        "max_rss_kb": max(run["max_rss_kb"] for run in runs),
+        "instructions": None if None in instructions else int(statistics.median(instructions)),
+    }
+
+
+def growth(new, old):
+    return (new - old) / old if old else 0.0
+
+
+def compare(args, result, old):
+    """The reasons result regressed against the baseline entry old."""
+    problems = []
+    if result["instructions"] is not None and old.get("instructions"):
+        change = growth(result["instructions"], old["instructions"])
+        if change > args.threshold:
+            problems.append("instructions %+.0f%% (%d -> %d)" % (100 * change, old["instructions"],
+                                                                  result["instructions"]))
+    else:
+        change = growth(result["wall_s"], old["wall_s"])
+        if change > args.threshold and result["wall_s"] - old["wall_s"] > args.min_wall_delta:
+            problems.append("wall time %+.0f%% (%.4fs -> %.4fs)" % (100 * change, old["wall_s"], result["wall_s"]))
+    change = growth(result["max_rss_kb"], old["max_rss_kb"])
+    if change > args.rss_threshold:
+        problems.append("peak RSS %+.0f%% (%d KiB -> %d KiB)" % (100 * change, old["max_rss_kb"],
+                                                                 result["max_rss_kb"]))
+    return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--interpreter", required=True, help="the code executable")
+    parser.add_argument("--interpreter-arg", action="append", default=[],
+                        help="extra argument for the interpreter (repeatable)")
+    parser.add_argument("--measure", required=True, help="the measure helper executable")
+    parser.add_argument("--cases", action="append",
+                        help="directory of .in/.out pairs (repeatable; default: every testcases/ subdirectory)")
+    parser.add_argument("--runs", type=int, default=3, help="runs per case (default 3)")
+    parser.add_argument("--timeout", type=int, default=60, help="seconds before a run is killed (default 60)")
+    parser.add_argument("--baseline", help="baseline JSON to compare against")
+    parser.add_argument("--write-baseline", help="store the results as a baseline here")
+    parser.add_argument("--threshold", type=float, default=0.25, help="allowed cost growth (default 0.25)")
+    parser.add_argument("--rss-threshold", type=float, default=0.5, help="allowed peak RSS growth (default 0.5)")
+    parser.add_argument("--min-wall-delta", type=float, default=0.02,
+                        help="wall time growth in seconds always tolerated (default 0.02)")
+    args = parser.parse_args()
+    if args.runs < 1:
+        parser.error("--runs must be at least 1")
+
+    testcases = os.path.join(ROOT, "testcases")
+    directories = args.cases or [os.path.join(testcases, d) for d in sorted(os.listdir(testcases))
+                                 if os.path.isdir(os.path.join(testcases, d))]
+    baseline = {}
+    if args.baseline:
+        if os.path.exists(args.baseline):
+            with open(args.baseline) as f:
+                baseline = json.load(f)["cases"]
+        else:
+            print("no baseline at %s yet; recording only" % args.baseline)
+
+    results = {}
+    failures = 0
+    with tempfile.TemporaryDirectory() as scratch_dir:
+        scratch = os.path.join(scratch_dir, "out")
+        for case in find_cases(directories):
+            name = case_name(case)
+            result = run_case(args, case, scratch)
+            results[name] = result
+            problems = []
+            if not result["correct"]:
+                problems.append("wrong output" if result["status"] < 128 else "killed (status %d)" % result["status"])
+            elif name in baseline:
+                problems = compare(args, result, baseline[name])
+            failures += bool(problems)
+            instructions = "-" if result["instructions"] is None else "%d" % result["instructions"]
+            print("%-40s %9.4fs %8d KiB %14s  %s" % (name, result["wall_s"], result["max_rss_kb"], instructions,
+                                                     "; ".join(problems) or "ok"), flush=True)
+
+    if args.write_baseline:
+        with open(args.write_baseline, "w") as f:
+            json.dump({"runs": args.runs, "interpreter_args": args.interpreter_arg, "cases": results}, f, indent=2,
+                      sort_keys=True)
+            f.write("\n")
+        print("baseline written to " + args.write_baseline)
+    print("%d of %d cases failed or regressed" % (failures, len(results)))
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
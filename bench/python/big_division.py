@@ -0,0 +1,14 @@
+# Division and remainder of big integers by big and small divisors.
+a = 1
+i = 0
+while i < 400:
+    a = a * 1000003 + i
+    i += 1
+b = a // 99999999977
+count = 0
+while count < 200:
+    q = a // b
+    r = a % b
+    a = a - q - r + count
+    count += 1
+print(q, r)
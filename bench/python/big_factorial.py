@@ -0,0 +1,7 @@
+# Repeated multiplication of a growing big integer by a small one.
+n = 1
+i = 1
+while i <= 1000:
+    n = n * i
+    i += 1
+print(n)
@@ -0,0 +1,5 @@
+# Formatting through f-strings and writing many short lines.
+i = 0
+while i < 100000:
+    print(f"row {i}: {i * 3} {i % 7 == 0} {True}")
+    i += 1
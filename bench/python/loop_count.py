@@ -0,0 +1,7 @@
+# Counting loop: the dispatch and small-int arithmetic fast paths.
+i = 0
+total = 0
+while i < 2000000:
+    total += i
+    i += 1
+print(total)
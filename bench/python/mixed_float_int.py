@@ -0,0 +1,9 @@
+# Arithmetic mixing floats and ints, with conversions between them.
+x = 0.0
+i = 0
+total = 0
+while i < 100000:
+    x = x + i * 0.5 - i / 3
+    total += int(x) % 7
+    i += 1
+print(x, total)
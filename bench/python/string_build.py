@@ -0,0 +1,10 @@
+# Growing strings by concatenation and converting ints to text.
+line = 0
+while line < 200:
+    s = ""
+    i = 0
+    while i < 500:
+        s += str(i % 10)
+        i += 1
+    line += 1
+print(s)
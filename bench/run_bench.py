@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""Run the benchmark suite and write the results as JSON.
+
+Every script in bench/python is run through the interpreter --warmup times
+untimed and then --runs times timed; the median wall time is reported. A
+script must exit with status 0 and print the same output on every run.
+The int2048 micro-benchmarks report their own medians (see
+int2048_bench.cpp) and are merged into the same result file.
+
+Usually run through the build: cmake --build build --target bench
+"""
+import argparse
+import hashlib
+import json
+import os
+import platform
+import statistics
+import subprocess
+import sys
+import time
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+
+
+def git_commit():
+    try:
+        return subprocess.run(["git", "rev-parse", "HEAD"], cwd=BENCH_DIR, capture_output=True,
+                              text=True, check=True).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def run_script(interpreter, script, extra_args):
+    start = time.perf_counter()
+    result = subprocess.run([interpreter] + extra_args + [script], stdout=subprocess.PIPE,
+                            stderr=subprocess.PIPE)
+    elapsed = time.perf_counter() - start
+    if result.returncode != 0:
+        sys.exit("%s failed with status %d:\n%s" % (script, result.returncode, result.stderr.decode()))
+    return elapsed, hashlib.sha256(result.stdout).hexdigest()
+
+
+def bench_python(args):
+    scripts = sorted(f for f in os.listdir(os.path.join(BENCH_DIR, "python")) if f.endswith(".py"))
+    results = []
+    for name in scripts:
+        if args.filter and args.filter not in name:
+            continue
+        script = os.path.join(BENCH_DIR, "python", name)
+        digests = set()
+        for _ in range(args.warmup):
+            digests.add(run_script(args.interpreter, script, args.interpreter_arg)[1])
+        samples = []
+        for _ in range(args.runs):
+            elapsed, digest = run_script(args.interpreter, script, args.interpreter_arg)
+            samples.append(elapsed)
+            digests.add(digest)
+        if len(digests) != 1:
+            sys.exit("%s printed different output on different runs" % script)
+        row = {
+            "name": "python/" + name[:-3],
+            "median_s": statistics.median(samples),
+            "min_s": min(samples),
+            "max_s": max(samples),
+            "samples_s": samples,
+            "output_sha256": digests.pop(),
+        }
+        print("%-32s %10.4f s  (min %.4f, max %.4f)" % (row["name"], row["median_s"], row["min_s"], row["max_s"]),
+              flush=True)
+        results.append(row)
+    return results
+
+
+def bench_int2048(args):
+    command = [args.int2048_bench, "--samples=%d" % args.runs]
+    if args.quick:
+        command.append("--quick")
+    results = []
+    process = subprocess.Popen(command, stdout=subprocess.PIPE, text=True)
+    for line in process.stdout:
+        row = json.loads(line)
+        if args.filter and args.filter not in row["name"]:
+            continue
+        print("%-32s %10.1f ns (min %.1f, max %.1f)" % (row["name"], row["ns_per_op"], row["min_ns"], row["max_ns"]),
+              flush=True)
+        results.append(row)
+    if process.wait() != 0:
+        sys.exit("%s failed with status %d" % (args.int2048_bench, process.returncode))
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--interpreter", required=True, help="the code executable")
+    parser.add_argument("--interpreter-arg", action="append", default=[],
+                        help="extra argument for the interpreter, e.g. --engine=tree (repeatable)")
+    parser.add_argument("--int2048-bench", help="the int2048_bench executable; skipped if not given")
+    parser.add_argument("--runs", type=int, default=5, help="timed runs per benchmark (default 5)")
+    parser.add_argument("--warmup", type=int, default=1, help="untimed runs first (default 1)")
+    parser.add_argument("--filter", help="only benchmarks whose name contains this")
+    parser.add_argument("--quick", action="store_true", help="skip the largest int2048 sizes")
+    parser.add_argument("--output", help="where to write the JSON results (default: stdout only)")
+    args = parser.parse_args()
+    if args.runs < 1 or args.warmup < 0:
+        parser.error("--runs must be at least 1 and --warmup at least 0")
+
+    report = {
+        "commit": git_commit(),
+        "timestamp": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+        "machine": {"node": platform.node(), "processor": platform.machine(), "cpus": os.cpu_count()},
+        "interpreter_args": args.interpreter_arg,
+        "runs": args.runs,
+        "warmup": args.warmup,
+        "benchmarks": bench_python(args),
+    }
+    if args.int2048_bench:
+        report["benchmarks"] += bench_int2048(args)
+    if args.output:
+        with open(args.output, "w") as out:
+            json.dump(report, out, indent=2)
+            out.write("\n")
+        print("results written to " + args.output)
+
+
+if __name__ == "__main__":
+    main()
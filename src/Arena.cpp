@@ -0,0 +1,29 @@
+#include "Arena.h"
+#include "Memory.h"
+#include <cstdlib>
+
+Arena::~Arena() {
+  for (auto it = destructors.rbegin(); it != destructors.rend(); ++it) {
+    it->run(it->objects, it->count);
+  }
+  for (auto chunk : chunks) {
+    free(chunk);
+  }
+  memoryBudget().release(MemoryBudget::PARSE_TREE, reserved);
+}
+
+void *Arena::allocateSlow(size_t size, size_t align) {
+  // oversized requests get a chunk of their own
+  size_t chunkSize = size + align > CHUNK_SIZE ? size + align : CHUNK_SIZE;
+  memoryBudget().charge(MemoryBudget::PARSE_TREE, chunkSize);
+  char *chunk = static_cast<char *>(malloc(chunkSize));
+  if (!chunk) throw std::bad_alloc();
+  chunks.push_back(chunk);
+  used += cursor - chunkStart;
+  reserved += chunkSize;
+  chunkStart = cursor = chunk;
+  limit = chunk + chunkSize;
+  uintptr_t p = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t)(align - 1);
+  cursor = reinterpret_cast<char *>(p + size);
+  return reinterpret_cast<void *>(p);
+}
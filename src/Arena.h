@@ -0,0 +1,87 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_ARENA_H
+#define PYTHON_INTERPRETER_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator. Objects are carved one after another out of large
+// chunks, so objects created together sit together in memory, and the
+// whole arena is released at once when it is destroyed. Objects with
+// non-trivial destructors are destroyed then too, in reverse order.
+class Arena {
+public:
+  static const size_t CHUNK_SIZE = 64 * 1024;
+
+  Arena() = default;
+  ~Arena();
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  void *allocate(size_t size, size_t align) {
+    uintptr_t p = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t)(align - 1);
+    if (!cursor || p + size > reinterpret_cast<uintptr_t>(limit)) {
+      return allocateSlow(size, align);
+    }
+    cursor = reinterpret_cast<char *>(p + size);
+    return reinterpret_cast<void *>(p);
+  }
+
+  template <typename T, typename... Args>
+  T *create(Args &&...args) {
+    T *object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value) {
+      destructors.push_back(Destructor{&destroy<T>, object, 1});
+    }
+    return object;
+  }
+
+  // Move the elements of items into a contiguous array in the arena.
+  template <typename T>
+  T *createArray(std::vector<T> &items) {
+    if (items.empty()) return nullptr;
+    T *array = static_cast<T *>(allocate(sizeof(T) * items.size(), alignof(T)));
+    for (size_t i = 0; i < items.size(); ++i) {
+      new (array + i) T(std::move(items[i]));
+    }
+    if (!std::is_trivially_destructible<T>::value) {
+      destructors.push_back(Destructor{&destroy<T>, array, items.size()});
+    }
+    return array;
+  }
+
+  // Bytes handed out so far, including alignment padding.
+  size_t bytesUsed() const { return used + (cursor - chunkStart); }
+  // Bytes reserved from the system.
+  size_t bytesReserved() const { return reserved; }
+
+private:
+  struct Destructor {
+    void (*run)(void *, size_t);
+    void *objects;
+    size_t count;
+  };
+
+  template <typename T>
+  static void destroy(void *objects, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      static_cast<T *>(objects)[i].~T();
+    }
+  }
+
+  std::vector<char *> chunks;
+  std::vector<Destructor> destructors;
+  char *chunkStart = nullptr;
+  char *cursor = nullptr;
+  char *limit = nullptr;
+  size_t used = 0;
+  size_t reserved = 0;
+
+  void *allocateSlow(size_t size, size_t align);
+};
+
+#endif//PYTHON_INTERPRETER_ARENA_H
@@ -0,0 +1,257 @@
+#include "Ast.h"
+#include <cstdio>
+
+namespace ast {
+
+Value numberValue(const std::string &text) {
+  if (text.find_first_of(".eE") != std::string::npos) {
+    return Value(std::stod(text));
+  }
+  return Value(sjtu::int2048(text));
+}
+
+void appendStringValue(std::string &out, const std::string &raw) {
+  char quote = raw[0];
+  const char *content = raw.data() + 1;
+  size_t length = raw.length() - 2;
+  for (size_t i = 0; i < length; ++i) {
+    if (content[i] == '\\' && i + 1 < length) {
+      char next = content[i + 1];
+      if (next == 'n') {
+        out += '\n';
+        i++;
+      } else if (next == 't') {
+        out += '\t';
+        i++;
+      } else if (next == 'r') {
+        out += '\r';
+        i++;
+      } else if (next == '\\' || next == quote) {
+        out += next;
+        i++;
+      } else {
+        out += content[i];
+      }
+    } else {
+      out += content[i];
+    }
+  }
+}
+
+void appendFormatLiteral(std::string &out, const std::string &raw) {
+  for (size_t i = 0; i < raw.length(); ++i) {
+    out += raw[i];
+    if ((raw[i] == '{' || raw[i] == '}') && i + 1 < raw.length() && raw[i + 1] == raw[i]) {
+      i++;
+    }
+  }
+}
+
+static void dumpString(std::string &out, const std::string &str) {
+  out += '"';
+  for (unsigned char c : str) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (c < 0x20 || c >= 0x7f) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\x%02x", c);
+      out += buf;
+    } else {
+      out += c;
+    }
+  }
+  out += '"';
+}
+
+static void dumpExpr(std::string &out, const Expr *expr);
+
+static void dumpExprs(std::string &out, const List<Expr *> &exprs) {
+  for (auto expr : exprs) {
+    out += ' ';
+    dumpExpr(out, expr);
+  }
+}
+
+static void dumpExpr(std::string &out, const Expr *expr) {
+  switch (expr->kind) {
+    case Expr::NAME:
+      out += static_cast<const NameExpr *>(expr)->name;
+      break;
+    case Expr::CONSTANT: {
+      const Value &value = static_cast<const ConstantExpr *>(expr)->value;
+      if (value.type() == Value::STR) {
+        dumpString(out, value.asStr());
+      } else if (value.type() == Value::FLOAT) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.17g", value.asFloat());
+        out += buf;
+      } else {
+        out += toStr(value);
+      }
+      break;
+    }
+    case Expr::FSTRING: {
+      auto fstring = static_cast<const FStringExpr *>(expr);
+      out += "(f ";
+      dumpString(out, fstring->literals[0]);
+      for (size_t i = 0; i < fstring->slots.size(); ++i) {
+        out += " {";
+        dumpExprs(out, fstring->slots[i]);
+        out += " } ";
+        dumpString(out, fstring->literals[i + 1]);
+      }
+      out += ')';
+      break;
+    }
+    case Expr::UNARY: {
+      auto unary = static_cast<const UnaryExpr *>(expr);
+      out += unary->op == UnaryExpr::PLUS ? "(+ " : unary->op == UnaryExpr::MINUS ? "(- " : "(not ";
+      dumpExpr(out, unary->operand);
+      out += ')';
+      break;
+    }
+    case Expr::BINARY: {
+      auto binary = static_cast<const BinaryExpr *>(expr);
+      out += '(';
+      out += binaryOpName(binary->op);
+      out += ' ';
+      dumpExpr(out, binary->left);
+      out += ' ';
+      dumpExpr(out, binary->right);
+      out += ')';
+      break;
+    }
+    case Expr::COMPARE: {
+      auto compare = static_cast<const CompareExpr *>(expr);
+      out += "(compare ";
+      dumpExpr(out, compare->operands[0]);
+      for (size_t i = 0; i < compare->ops.size(); ++i) {
+        out += ' ';
+        out += binaryOpName(compare->ops[i]);
+        out += ' ';
+        dumpExpr(out, compare->operands[i + 1]);
+      }
+      out += ')';
+      break;
+    }
+    case Expr::BOOLEAN: {
+      auto boolean = static_cast<const BooleanExpr *>(expr);
+      out += boolean->isAnd ? "(and" : "(or";
+      dumpExprs(out, boolean->operands);
+      out += ')';
+      break;
+    }
+    case Expr::CALL: {
+      auto call = static_cast<const CallExpr *>(expr);
+      out += "(call " + call->name;
+      for (size_t i = 0; i < call->args.size(); ++i) {
+        out += ' ';
+        if (!call->keywords[i].empty()) out += call->keywords[i] + '=';
+        dumpExpr(out, call->args[i]);
+      }
+      out += ')';
+      break;
+    }
+  }
+}
+
+static void dumpSuite(std::string &out, const Suite &suite, int depth);
+
+static void dumpStmt(std::string &out, const Stmt *stmt, int depth) {
+  out += std::to_string(stmt->line) + ':';
+  out.append(depth * 2 + 1, ' ');
+  switch (stmt->kind) {
+    case Stmt::EXPR:
+      out += "expr";
+      dumpExprs(out, static_cast<const ExprStmt *>(stmt)->values);
+      out += '\n';
+      break;
+    case Stmt::ASSIGN: {
+      auto assign = static_cast<const AssignStmt *>(stmt);
+      out += "assign";
+      for (auto &targets : assign->targets) {
+        for (auto &name : targets) out += ' ' + name;
+        out += " =";
+      }
+      dumpExprs(out, assign->values);
+      out += '\n';
+      break;
+    }
+    case Stmt::AUGASSIGN: {
+      auto assign = static_cast<const AugAssignStmt *>(stmt);
+      out += "augassign";
+      for (auto &name : assign->targets) out += ' ' + name;
+      out += ' ';
+      out += binaryOpName(assign->op);
+      out += '=';
+      dumpExprs(out, assign->values);
+      out += '\n';
+      break;
+    }
+    case Stmt::IF: {
+      auto ifStmt = static_cast<const IfStmt *>(stmt);
+      for (size_t i = 0; i < ifStmt->conditions.size(); ++i) {
+        if (i > 0) out.append(depth * 2 + 1, ' ');
+        out += i == 0 ? "if " : "elif ";
+        dumpExpr(out, ifStmt->conditions[i]);
+        out += '\n';
+        dumpSuite(out, ifStmt->bodies[i], depth + 1);
+      }
+      if (ifStmt->hasElse) {
+        out.append(depth * 2 + 1, ' ');
+        out += "else\n";
+        dumpSuite(out, ifStmt->orelse, depth + 1);
+      }
+      break;
+    }
+    case Stmt::WHILE: {
+      auto whileStmt = static_cast<const WhileStmt *>(stmt);
+      out += "while ";
+      dumpExpr(out, whileStmt->condition);
+      out += '\n';
+      dumpSuite(out, whileStmt->body, depth + 1);
+      break;
+    }
+    case Stmt::FUNCDEF: {
+      auto def = static_cast<const FuncDef *>(stmt);
+      out += "def " + def->name + " (";
+      for (size_t i = 0; i < def->parameters.size(); ++i) {
+        if (i > 0) out += ' ';
+        out += def->parameters[i].name;
+        if (def->parameters[i].defaultValue) {
+          out += '=';
+          dumpExpr(out, def->parameters[i].defaultValue);
+        }
+      }
+      out += ")\n";
+      dumpSuite(out, def->body, depth + 1);
+      break;
+    }
+    case Stmt::RETURN:
+      out += "return";
+      dumpExprs(out, static_cast<const ReturnStmt *>(stmt)->values);
+      out += '\n';
+      break;
+    case Stmt::BREAK:
+      out += "break\n";
+      break;
+    case Stmt::CONTINUE:
+      out += "continue\n";
+      break;
+  }
+}
+
+static void dumpSuite(std::string &out, const Suite &suite, int depth) {
+  for (auto stmt : suite) {
+    dumpStmt(out, stmt, depth);
+  }
+}
+
+std::string dump(const Program &program) {
+  std::string out;
+  dumpSuite(out, program.body, 0);
+  return out;
+}
+
+} // namespace ast
@@ -0,0 +1,208 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_AST_H
+#define PYTHON_INTERPRETER_AST_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Arena.h"
+#include "Value.h"
+
+// The interpreter's own syntax tree. It is independent of ANTLR: a front end
+// lowers its parse tree into this form and the compiler only ever sees it.
+namespace ast {
+
+// A fixed-size array living in the Program's arena.
+template <typename T>
+class List {
+public:
+  List() = default;
+  List(T *data, size_t size) : items(data), count((uint32_t)size) {}
+
+  T *begin() const { return items; }
+  T *end() const { return items + count; }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  T &operator[](size_t i) const { return items[i]; }
+  T &front() const { return items[0]; }
+  T &back() const { return items[count - 1]; }
+
+private:
+  T *items = nullptr;
+  uint32_t count = 0;
+};
+
+// Nodes are not polymorphic: the kind field says what a node is, and the
+// arena destroys each node as the type it was created with.
+struct Node {
+  int line = 0;
+};
+
+struct Expr : Node {
+  enum Kind { NAME, CONSTANT, FSTRING, UNARY, BINARY, COMPARE, BOOLEAN, CALL } kind;
+  explicit Expr(Kind kind) : kind(kind) {}
+};
+
+struct NameExpr : Expr {
+  std::string name;
+  NameExpr() : Expr(NAME) {}
+};
+
+// A literal; numbers are parsed and strings unescaped when the tree is built.
+struct ConstantExpr : Expr {
+  Value value;
+  ConstantExpr() : Expr(CONSTANT) {}
+};
+
+// f"...": literals[i] comes before slots[i], and there is one literal more
+// than there are slots. Each slot is the testlist between one pair of braces.
+struct FStringExpr : Expr {
+  List<std::string> literals;
+  List<List<Expr *>> slots;
+  FStringExpr() : Expr(FSTRING) {}
+};
+
+struct UnaryExpr : Expr {
+  enum Op { PLUS, MINUS, NOT } op;
+  Expr *operand = nullptr;
+  UnaryExpr() : Expr(UNARY) {}
+};
+
+// Arithmetic: + - * / // %, left-associative chains are nested to the left.
+struct BinaryExpr : Expr {
+  BinaryOp op;
+  Expr *left = nullptr;
+  Expr *right = nullptr;
+  BinaryExpr() : Expr(BINARY) {}
+};
+
+// a < b <= c: operands.size() == ops.size() + 1, evaluated with short-circuit.
+struct CompareExpr : Expr {
+  List<Expr *> operands;
+  List<BinaryOp> ops;
+  CompareExpr() : Expr(COMPARE) {}
+};
+
+// and / or over two or more operands. The result is always a bool.
+struct BooleanExpr : Expr {
+  bool isAnd = false;
+  List<Expr *> operands;
+  BooleanExpr() : Expr(BOOLEAN) {}
+};
+
+// name(args); keywords[i] is empty for a positional argument.
+struct CallExpr : Expr {
+  std::string name;
+  List<Expr *> args;
+  List<std::string> keywords;
+  CallExpr() : Expr(CALL) {}
+};
+
+struct Stmt : Node {
+  enum Kind { EXPR, ASSIGN, AUGASSIGN, IF, WHILE, FUNCDEF, RETURN, BREAK, CONTINUE } kind;
+  explicit Stmt(Kind kind) : kind(kind) {}
+};
+
+using Suite = List<Stmt *>;
+
+struct ExprStmt : Stmt {
+  List<Expr *> values;
+  ExprStmt() : Stmt(EXPR) {}
+};
+
+// t1 = t2 = ... = values; every target list holds names only.
+struct AssignStmt : Stmt {
+  List<List<std::string>> targets;
+  List<Expr *> values;
+  AssignStmt() : Stmt(ASSIGN) {}
+};
+
+// targets op= values, applied element by element.
+struct AugAssignStmt : Stmt {
+  List<std::string> targets;
+  BinaryOp op;
+  List<Expr *> values;
+  AugAssignStmt() : Stmt(AUGASSIGN) {}
+};
+
+struct IfStmt : Stmt {
+  List<Expr *> conditions;
+  List<Suite> bodies;
+  bool hasElse = false;
+  Suite orelse;
+  IfStmt() : Stmt(IF) {}
+};
+
+struct WhileStmt : Stmt {
+  Expr *condition = nullptr;
+  Suite body;
+  WhileStmt() : Stmt(WHILE) {}
+};
+
+struct Parameter {
+  std::string name;
+  Expr *defaultValue = nullptr;
+};
+
+struct FuncDef : Stmt {
+  std::string name;
+  List<Parameter> parameters;
+  Suite body;
+  FuncDef() : Stmt(FUNCDEF) {}
+};
+
+struct ReturnStmt : Stmt {
+  List<Expr *> values;
+  ReturnStmt() : Stmt(RETURN) {}
+};
+
+struct BreakStmt : Stmt {
+  BreakStmt() : Stmt(BREAK) {}
+};
+
+struct ContinueStmt : Stmt {
+  ContinueStmt() : Stmt(CONTINUE) {}
+};
+
+// A whole script. Every node and child list reachable from body lives in
+// its arena, so building the tree is a run of bump allocations and the
+// nodes of one statement end up next to each other.
+class Program {
+public:
+  Suite body;
+
+  template <typename T>
+  T *make(int line) {
+    T *node = arena.create<T>();
+    node->line = line;
+    return node;
+  }
+
+  // Move items into the arena as a child list.
+  template <typename T>
+  List<T> list(std::vector<T> &&items) {
+    size_t size = items.size();
+    return List<T>(arena.createArray(items), size);
+  }
+
+  size_t bytesUsed() const { return arena.bytesUsed(); }
+
+private:
+  Arena arena;
+};
+
+// Literal token text to values, shared by both front ends so that they
+// agree byte for byte with EvalVisitor::visitAtom.
+// A NUMBER token: a float if it has a '.' or an exponent, else an int.
+Value numberValue(const std::string &text);
+// Strip the quotes of a STRING token, translate its escapes and append it.
+void appendStringValue(std::string &out, const std::string &raw);
+// Append the text of a FORMAT_STRING_LITERAL token with {{ and }} collapsed.
+void appendFormatLiteral(std::string &out, const std::string &raw);
+// A readable dump of the whole tree, one statement per line, used to
+// cross-check the front ends against each other.
+std::string dump(const Program &program);
+
+} // namespace ast
+
+#endif//PYTHON_INTERPRETER_AST_H
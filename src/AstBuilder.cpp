@@ -0,0 +1,355 @@
+#include "AstBuilder.h"
+#include <stdexcept>
+
+static int lineOf(antlr4::ParserRuleContext *ctx) {
+  return ctx->getStart()->getLine();
+}
+
+std::unique_ptr<ast::Program> AstBuilder::build(Python3Parser::File_inputContext *ctx) {
+  auto result = std::make_unique<ast::Program>();
+  program = result.get();
+  std::vector<ast::Stmt *> body;
+  for (auto stmt : ctx->stmt()) {
+    lowerStmt(stmt, body);
+  }
+  program->body = program->list(std::move(body));
+  program = nullptr;
+  return result;
+}
+
+void AstBuilder::lowerStmt(Python3Parser::StmtContext *ctx, std::vector<ast::Stmt *> &out) {
+  if (ctx->simple_stmt()) {
+    lowerSimpleStmt(ctx->simple_stmt(), out);
+  } else {
+    out.push_back(lowerCompoundStmt(ctx->compound_stmt()));
+  }
+}
+
+void AstBuilder::lowerSimpleStmt(Python3Parser::Simple_stmtContext *ctx, std::vector<ast::Stmt *> &out) {
+  auto small = ctx->small_stmt();
+  if (small->expr_stmt()) {
+    out.push_back(lowerExprStmt(small->expr_stmt()));
+  } else {
+    out.push_back(lowerFlowStmt(small->flow_stmt()));
+  }
+}
+
+ast::Stmt *AstBuilder::lowerExprStmt(Python3Parser::Expr_stmtContext *ctx) {
+  auto testlists = ctx->testlist();
+  if (auto aug = ctx->augassign()) {
+    auto stmt = program->make<ast::AugAssignStmt>(lineOf(ctx));
+    stmt->targets = lowerTargets(testlists[0]);
+    if (aug->ADD_ASSIGN()) stmt->op = BinaryOp::ADD;
+    else if (aug->SUB_ASSIGN()) stmt->op = BinaryOp::SUB;
+    else if (aug->MULT_ASSIGN()) stmt->op = BinaryOp::MUL;
+    else if (aug->DIV_ASSIGN()) stmt->op = BinaryOp::DIV;
+    else if (aug->IDIV_ASSIGN()) stmt->op = BinaryOp::IDIV;
+    else stmt->op = BinaryOp::MOD;
+    stmt->values = lowerTestlist(testlists[1]);
+    return stmt;
+  }
+  if (testlists.size() == 1) {
+    auto stmt = program->make<ast::ExprStmt>(lineOf(ctx));
+    stmt->values = lowerTestlist(testlists[0]);
+    return stmt;
+  }
+  auto stmt = program->make<ast::AssignStmt>(lineOf(ctx));
+  // targets are assigned right to left, like EvalVisitor::visitExpr_stmt
+  std::vector<ast::List<std::string>> targets;
+  for (int i = (int)testlists.size() - 2; i >= 0; --i) {
+    targets.push_back(lowerTargets(testlists[i]));
+  }
+  stmt->targets = program->list(std::move(targets));
+  stmt->values = lowerTestlist(testlists.back());
+  return stmt;
+}
+
+ast::Stmt *AstBuilder::lowerFlowStmt(Python3Parser::Flow_stmtContext *ctx) {
+  if (ctx->break_stmt()) {
+    return program->make<ast::BreakStmt>(lineOf(ctx));
+  }
+  if (ctx->continue_stmt()) {
+    return program->make<ast::ContinueStmt>(lineOf(ctx));
+  }
+  auto ret = ctx->return_stmt();
+  auto stmt = program->make<ast::ReturnStmt>(lineOf(ctx));
+  if (ret->testlist()) {
+    stmt->values = lowerTestlist(ret->testlist());
+  }
+  return stmt;
+}
+
+ast::Stmt *AstBuilder::lowerCompoundStmt(Python3Parser::Compound_stmtContext *ctx) {
+  if (auto ifCtx = ctx->if_stmt()) {
+    auto stmt = program->make<ast::IfStmt>(lineOf(ifCtx));
+    auto tests = ifCtx->test();
+    auto suites = ifCtx->suite();
+    std::vector<ast::Expr *> conditions;
+    std::vector<ast::Suite> bodies;
+    for (size_t i = 0; i < tests.size(); ++i) {
+      conditions.push_back(lowerTest(tests[i]));
+      bodies.push_back(lowerSuite(suites[i]));
+    }
+    stmt->conditions = program->list(std::move(conditions));
+    stmt->bodies = program->list(std::move(bodies));
+    if (suites.size() > tests.size()) {
+      stmt->hasElse = true;
+      stmt->orelse = lowerSuite(suites.back());
+    }
+    return stmt;
+  }
+  if (auto whileCtx = ctx->while_stmt()) {
+    auto stmt = program->make<ast::WhileStmt>(lineOf(whileCtx));
+    stmt->condition = lowerTest(whileCtx->test());
+    stmt->body = lowerSuite(whileCtx->suite());
+    return stmt;
+  }
+  auto funcCtx = ctx->funcdef();
+  auto stmt = program->make<ast::FuncDef>(lineOf(funcCtx));
+  stmt->name = funcCtx->NAME()->getText();
+  if (auto args = funcCtx->parameters()->typedargslist()) {
+    auto names = args->tfpdef();
+    auto defaults = args->test();
+    size_t firstDefault = names.size() - defaults.size();
+    std::vector<ast::Parameter> parameters;
+    for (size_t i = 0; i < names.size(); ++i) {
+      ast::Parameter param;
+      param.name = names[i]->NAME()->getText();
+      if (i >= firstDefault) {
+        param.defaultValue = lowerTest(defaults[i - firstDefault]);
+      }
+      parameters.push_back(param);
+    }
+    stmt->parameters = program->list(std::move(parameters));
+  }
+  stmt->body = lowerSuite(funcCtx->suite());
+  return stmt;
+}
+
+ast::Suite AstBuilder::lowerSuite(Python3Parser::SuiteContext *ctx) {
+  std::vector<ast::Stmt *> suite;
+  if (ctx->simple_stmt()) {
+    lowerSimpleStmt(ctx->simple_stmt(), suite);
+  } else {
+    for (auto stmt : ctx->stmt()) {
+      lowerStmt(stmt, suite);
+    }
+  }
+  return program->list(std::move(suite));
+}
+
+ast::List<ast::Expr *> AstBuilder::lowerTestlist(Python3Parser::TestlistContext *ctx) {
+  std::vector<ast::Expr *> values;
+  for (auto test : ctx->test()) {
+    values.push_back(lowerTest(test));
+  }
+  return program->list(std::move(values));
+}
+
+ast::List<std::string> AstBuilder::lowerTargets(Python3Parser::TestlistContext *ctx) {
+  std::vector<std::string> names;
+  for (auto test : ctx->test()) {
+    auto expr = lowerTest(test);
+    if (expr->kind != ast::Expr::NAME) {
+      throw std::runtime_error("SyntaxError: cannot assign to expression (line " + std::to_string(expr->line) + ")");
+    }
+    names.push_back(static_cast<ast::NameExpr *>(expr)->name);
+  }
+  return program->list(std::move(names));
+}
+
+ast::Expr *AstBuilder::lowerTest(Python3Parser::TestContext *ctx) {
+  return lowerOrTest(ctx->or_test());
+}
+
+ast::Expr *AstBuilder::lowerOrTest(Python3Parser::Or_testContext *ctx) {
+  auto tests = ctx->and_test();
+  if (tests.size() == 1) {
+    return lowerAndTest(tests[0]);
+  }
+  auto expr = program->make<ast::BooleanExpr>(lineOf(ctx));
+  expr->isAnd = false;
+  std::vector<ast::Expr *> operands;
+  for (auto test : tests) {
+    operands.push_back(lowerAndTest(test));
+  }
+  expr->operands = program->list(std::move(operands));
+  return expr;
+}
+
+ast::Expr *AstBuilder::lowerAndTest(Python3Parser::And_testContext *ctx) {
+  auto tests = ctx->not_test();
+  if (tests.size() == 1) {
+    return lowerNotTest(tests[0]);
+  }
+  auto expr = program->make<ast::BooleanExpr>(lineOf(ctx));
+  expr->isAnd = true;
+  std::vector<ast::Expr *> operands;
+  for (auto test : tests) {
+    operands.push_back(lowerNotTest(test));
+  }
+  expr->operands = program->list(std::move(operands));
+  return expr;
+}
+
+ast::Expr *AstBuilder::lowerNotTest(Python3Parser::Not_testContext *ctx) {
+  if (ctx->NOT()) {
+    auto expr = program->make<ast::UnaryExpr>(lineOf(ctx));
+    expr->op = ast::UnaryExpr::NOT;
+    expr->operand = lowerNotTest(ctx->not_test());
+    return expr;
+  }
+  return lowerComparison(ctx->comparison());
+}
+
+ast::Expr *AstBuilder::lowerComparison(Python3Parser::ComparisonContext *ctx) {
+  auto operands = ctx->arith_expr();
+  if (operands.size() == 1) {
+    return lowerArithExpr(operands[0]);
+  }
+  auto expr = program->make<ast::CompareExpr>(lineOf(ctx));
+  std::vector<ast::Expr *> lowered;
+  for (auto operand : operands) {
+    lowered.push_back(lowerArithExpr(operand));
+  }
+  std::vector<BinaryOp> ops;
+  for (auto op : ctx->comp_op()) {
+    if (op->LESS_THAN()) ops.push_back(BinaryOp::LT);
+    else if (op->GREATER_THAN()) ops.push_back(BinaryOp::GT);
+    else if (op->EQUALS()) ops.push_back(BinaryOp::EQ);
+    else if (op->GT_EQ()) ops.push_back(BinaryOp::GE);
+    else if (op->LT_EQ()) ops.push_back(BinaryOp::LE);
+    else ops.push_back(BinaryOp::NE);
+  }
+  expr->operands = program->list(std::move(lowered));
+  expr->ops = program->list(std::move(ops));
+  return expr;
+}
+
+ast::Expr *AstBuilder::lowerArithExpr(Python3Parser::Arith_exprContext *ctx) {
+  auto terms = ctx->term();
+  auto ops = ctx->addorsub_op();
+  ast::Expr *result = lowerTerm(terms[0]);
+  for (size_t i = 0; i < ops.size(); ++i) {
+    auto expr = program->make<ast::BinaryExpr>(lineOf(ops[i]));
+    expr->op = ops[i]->ADD() ? BinaryOp::ADD : BinaryOp::SUB;
+    expr->left = result;
+    expr->right = lowerTerm(terms[i + 1]);
+    result = expr;
+  }
+  return result;
+}
+
+ast::Expr *AstBuilder::lowerTerm(Python3Parser::TermContext *ctx) {
+  auto factors = ctx->factor();
+  auto ops = ctx->muldivmod_op();
+  ast::Expr *result = lowerFactor(factors[0]);
+  for (size_t i = 0; i < ops.size(); ++i) {
+    auto expr = program->make<ast::BinaryExpr>(lineOf(ops[i]));
+    if (ops[i]->STAR()) expr->op = BinaryOp::MUL;
+    else if (ops[i]->DIV()) expr->op = BinaryOp::DIV;
+    else if (ops[i]->IDIV()) expr->op = BinaryOp::IDIV;
+    else expr->op = BinaryOp::MOD;
+    expr->left = result;
+    expr->right = lowerFactor(factors[i + 1]);
+    result = expr;
+  }
+  return result;
+}
+
+ast::Expr *AstBuilder::lowerFactor(Python3Parser::FactorContext *ctx) {
+  if (ctx->factor()) {
+    auto expr = program->make<ast::UnaryExpr>(lineOf(ctx));
+    expr->op = ctx->ADD() ? ast::UnaryExpr::PLUS : ast::UnaryExpr::MINUS;
+    expr->operand = lowerFactor(ctx->factor());
+    return expr;
+  }
+  return lowerAtomExpr(ctx->atom_expr());
+}
+
+ast::Expr *AstBuilder::lowerAtomExpr(Python3Parser::Atom_exprContext *ctx) {
+  auto trailer = ctx->trailer();
+  if (!trailer) {
+    return lowerAtom(ctx->atom());
+  }
+  if (!ctx->atom()->NAME()) {
+    throw std::runtime_error("SyntaxError: only functions can be called (line " + std::to_string(lineOf(ctx)) + ")");
+  }
+  auto call = program->make<ast::CallExpr>(lineOf(ctx));
+  call->name = ctx->atom()->NAME()->getText();
+  if (auto arglist = trailer->arglist()) {
+    std::vector<ast::Expr *> args;
+    std::vector<std::string> keywords;
+    for (auto arg : arglist->argument()) {
+      auto tests = arg->test();
+      if (tests.size() == 1) {
+        keywords.emplace_back();
+        args.push_back(lowerTest(tests[0]));
+      } else {
+        auto name = lowerTest(tests[0]);
+        if (name->kind != ast::Expr::NAME) {
+          throw std::runtime_error("SyntaxError: keyword must be a name (line " + std::to_string(lineOf(arg)) + ")");
+        }
+        keywords.push_back(static_cast<ast::NameExpr *>(name)->name);
+        args.push_back(lowerTest(tests[1]));
+      }
+    }
+    call->args = program->list(std::move(args));
+    call->keywords = program->list(std::move(keywords));
+  }
+  return call;
+}
+
+ast::Expr *AstBuilder::lowerAtom(Python3Parser::AtomContext *ctx) {
+  int line = lineOf(ctx);
+  if (ctx->NAME()) {
+    auto expr = program->make<ast::NameExpr>(line);
+    expr->name = ctx->NAME()->getText();
+    return expr;
+  }
+  if (ctx->test()) {
+    return lowerTest(ctx->test());
+  }
+  if (ctx->format_string()) {
+    return lowerFormatString(ctx->format_string());
+  }
+  auto expr = program->make<ast::ConstantExpr>(line);
+  if (ctx->NUMBER()) {
+    expr->value = ast::numberValue(ctx->NUMBER()->getText());
+  } else if (!ctx->STRING().empty()) {
+    std::string str;
+    for (auto strCtx : ctx->STRING()) {
+      ast::appendStringValue(str, strCtx->getText());
+    }
+    expr->value = Value(std::move(str));
+  } else if (ctx->TRUE()) {
+    expr->value = Value(true);
+  } else if (ctx->FALSE()) {
+    expr->value = Value(false);
+  } else {
+    expr->value = Value(None{});
+  }
+  return expr;
+}
+
+ast::Expr *AstBuilder::lowerFormatString(Python3Parser::Format_stringContext *ctx) {
+  auto expr = program->make<ast::FStringExpr>(lineOf(ctx));
+  std::vector<std::string> literals(1);
+  std::vector<ast::List<ast::Expr *>> slots;
+  // children are in source order: f" (literal | { testlist })* "
+  for (auto child : ctx->children) {
+    if (auto testlist = dynamic_cast<Python3Parser::TestlistContext *>(child)) {
+      slots.push_back(lowerTestlist(testlist));
+      literals.emplace_back();
+      continue;
+    }
+    auto terminal = dynamic_cast<antlr4::tree::TerminalNode *>(child);
+    if (!terminal || terminal->getSymbol()->getType() != Python3Parser::FORMAT_STRING_LITERAL) {
+      continue;
+    }
+    ast::appendFormatLiteral(literals.back(), terminal->getText());
+  }
+  expr->literals = program->list(std::move(literals));
+  expr->slots = program->list(std::move(slots));
+  return expr;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_ASTBUILDER_H
+#define PYTHON_INTERPRETER_ASTBUILDER_H
+
+#include <memory>
+#include "Ast.h"
+#include "Python3Parser.h"
+
+// Lowers an ANTLR parse tree into the interpreter's AST.
+// Literals are evaluated here, so the compiler never re-parses token text.
+// Throws runtime_error for constructs the compiled engine does not support,
+// such as assigning to something that is not a name.
+class AstBuilder {
+public:
+  std::unique_ptr<ast::Program> build(Python3Parser::File_inputContext *ctx);
+
+private:
+  ast::Program *program = nullptr;
+
+  void lowerStmt(Python3Parser::StmtContext *ctx, std::vector<ast::Stmt *> &out);
+  void lowerSimpleStmt(Python3Parser::Simple_stmtContext *ctx, std::vector<ast::Stmt *> &out);
+  ast::Stmt *lowerExprStmt(Python3Parser::Expr_stmtContext *ctx);
+  ast::Stmt *lowerFlowStmt(Python3Parser::Flow_stmtContext *ctx);
+  ast::Stmt *lowerCompoundStmt(Python3Parser::Compound_stmtContext *ctx);
+  ast::Suite lowerSuite(Python3Parser::SuiteContext *ctx);
+
+  ast::List<ast::Expr *> lowerTestlist(Python3Parser::TestlistContext *ctx);
+  ast::List<std::string> lowerTargets(Python3Parser::TestlistContext *ctx);
+  ast::Expr *lowerTest(Python3Parser::TestContext *ctx);
+  ast::Expr *lowerOrTest(Python3Parser::Or_testContext *ctx);
+  ast::Expr *lowerAndTest(Python3Parser::And_testContext *ctx);
+  ast::Expr *lowerNotTest(Python3Parser::Not_testContext *ctx);
+  ast::Expr *lowerComparison(Python3Parser::ComparisonContext *ctx);
+  ast::Expr *lowerArithExpr(Python3Parser::Arith_exprContext *ctx);
+  ast::Expr *lowerTerm(Python3Parser::TermContext *ctx);
+  ast::Expr *lowerFactor(Python3Parser::FactorContext *ctx);
+  ast::Expr *lowerAtomExpr(Python3Parser::Atom_exprContext *ctx);
+  ast::Expr *lowerAtom(Python3Parser::AtomContext *ctx);
+  ast::Expr *lowerFormatString(Python3Parser::Format_stringContext *ctx);
+};
+
+#endif//PYTHON_INTERPRETER_ASTBUILDER_H
@@ -0,0 +1,108 @@
+#include "Bytecode.h"
+
+static const char *const builtinNames[] = {"print", "int", "float", "str", "bool", "factorial"};
+
+Builtin findBuiltin(const std::string &name, bool library) {
+  int count = library ? (int)Builtin::BUILTIN_COUNT : (int)FIRST_LIBRARY;
+  for (int i = 0; i < count; ++i) {
+    if (name == builtinNames[i]) return static_cast<Builtin>(i);
+  }
+  return Builtin::BUILTIN_COUNT;
+}
+
+const char *builtinName(Builtin builtin) {
+  if (builtin >= Builtin::BUILTIN_COUNT) return "?";
+  return builtinNames[(int)builtin];
+}
+
+void CodeObject::seal() {
+  code = ownedCode.data();
+  lines = ownedLines.data();
+  size = ownedCode.size();
+}
+
+static bool validSlot(const Module &module, const CodeObject &code, int kind, int32_t index) {
+  switch (kind) {
+    case LOCAL_SLOT: return index >= 0 && index < (int32_t)code.locals.size();
+    case GLOBAL_SLOT: return index >= 0 && index < (int32_t)module.globals.size();
+    case CONST_SLOT: return index >= 0 && index < (int32_t)module.constants.size();
+    default: return false;
+  }
+}
+
+// The operands are in range and the generic instructions the fused one at
+// pc stands for follow it, ending in the expected instruction.
+static bool validFused(const Module &module, const CodeObject &code, uint32_t pc) {
+  const Instruction &ins = code.code[pc];
+  if (pc + 4 >= code.size || ins.c > (uint8_t)BinaryOp::NE) return false;
+  if (!validSlot(module, code, ins.kinds & 3, ins.a) || !validSlot(module, code, ins.kinds >> 2, ins.b)) return false;
+  Op last = code.code[pc + 4].op;
+  if (ins.op == Op::COMPARE_JUMP) {
+    return ins.c >= (uint8_t)BinaryOp::LT && last == Op::POP_JUMP_IF_FALSE;
+  }
+  return ins.c <= (uint8_t)BinaryOp::MUL && (ins.kinds & 3) != CONST_SLOT &&
+         (last == Op::STORE_NAME || last == Op::STORE_GLOBAL);
+}
+
+bool Module::validate() const {
+  if (codes.empty()) return false;
+  for (auto &site : callSites) {
+    if (site.name < 0 || site.name >= (int32_t)names.size()) return false;
+    for (auto keyword : site.keywords) {
+      if (keyword < -1 || keyword >= (int32_t)names.size()) return false;
+    }
+  }
+  for (auto &code : codes) {
+    if (code.numParams > code.locals.size() || code.numDefaults > code.numParams) return false;
+    if (code.size == 0 || code.code[code.size - 1].op != Op::RETURN_VALUE) return false;
+    for (uint32_t pc = 0; pc < code.size; ++pc) {
+      const Instruction &ins = code.code[pc];
+      bool ok = true;
+      switch (ins.op) {
+        case Op::LOAD_CONST:
+          ok = ins.a >= 0 && ins.a < (int32_t)constants.size();
+          break;
+        case Op::LOAD_GLOBAL:
+        case Op::STORE_GLOBAL:
+          ok = ins.a >= 0 && ins.a < (int32_t)globals.size();
+          break;
+        case Op::LOAD_NAME:
+        case Op::STORE_NAME:
+          ok = ins.a >= 0 && ins.a < (int32_t)code.locals.size() && ins.b >= 0 && ins.b < (int32_t)globals.size();
+          break;
+        case Op::BINARY:
+          ok = ins.a >= 0 && ins.a <= (int32_t)BinaryOp::NE && ins.b >= 0 && ins.b < (int32_t)code.size;
+          break;
+        case Op::JUMP:
+        case Op::POP_JUMP_IF_FALSE:
+        case Op::JUMP_IF_FALSE_OR_POP:
+        case Op::JUMP_IF_TRUE_OR_POP:
+          ok = ins.a >= 0 && ins.a < (int32_t)code.size;
+          break;
+        case Op::BUILD_TUPLE:
+        case Op::UNPACK:
+        case Op::BUILD_STRING:
+          ok = ins.a >= 0;
+          break;
+        case Op::CALL:
+          ok = ins.a >= 0 && ins.a < (int32_t)callSites.size();
+          break;
+        case Op::CALL_BUILTIN:
+          ok = ins.a >= 0 && ins.a < (int32_t)Builtin::BUILTIN_COUNT && ins.b >= 0;
+          break;
+        case Op::DEF_FUNCTION:
+          ok = ins.a > 0 && ins.a < (int32_t)codes.size() && ins.b >= 0 && ins.b < (int32_t)names.size();
+          break;
+        case Op::COMPARE_JUMP:
+        case Op::UPDATE:
+          ok = validFused(*this, code, pc);
+          break;
+        default:
+          ok = ins.op < Op::OP_COUNT;
+          break;
+      }
+      if (!ok) return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,124 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_BYTECODE_H
+#define PYTHON_INTERPRETER_BYTECODE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Value.h"
+
+// Instruction set of the compiled engine: a stack machine.
+// Operands a and b are described next to each opcode.
+enum class Op : uint8_t {
+  NOP,
+  LOAD_CONST,           // push constants[a]
+  LOAD_GLOBAL,          // push globals[a]
+  STORE_GLOBAL,         // globals[a] = pop
+  LOAD_NAME,            // push local a if bound, else globals[b]
+  STORE_NAME,           // store into local a if bound, else globals[b] if bound, else local a
+  POP_TOP,
+  DUP_TOP,
+  ROT_TWO,              // swap the two topmost values
+  ROT_THREE,            // move the top value below the next two
+  BINARY,               // a is a BinaryOp, b the index of its inline cache in the code object
+  UNARY_PLUS,
+  UNARY_MINUS,
+  NOT,
+  TO_BOOL,
+  JUMP,                 // jump to instruction a
+  POP_JUMP_IF_FALSE,
+  JUMP_IF_FALSE_OR_POP, // if top is false jump to a and keep it, else pop it
+  JUMP_IF_TRUE_OR_POP,
+  BUILD_TUPLE,          // pop a values into a tuple, splicing nested tuples
+  UNPACK,               // pop a tuple, push its first a elements (element 0 on top)
+  BUILD_STRING,         // pop a values and push the concatenation of their str()
+  CALL,                 // call through callSites[a]
+  CALL_BUILTIN,         // call builtin a with b arguments
+  DEF_FUNCTION,         // bind names[b] to codes[a], popping its default values
+  RETURN_VALUE,
+  COMPARE_JUMP,         // fused: a c b; POP_JUMP_IF_FALSE (see below)
+  UPDATE,               // fused: a = a c b (see below)
+  OP_COUNT
+};
+
+// Fused instructions are guarded fast paths for small ints (at most
+// int2048::SMALL_LIMBS limbs). Each one is immediately followed by the four
+// generic instructions it stands for and skips them when its guard holds;
+// otherwise it falls through and they run as usual. Operands a and b are
+// slots whose kinds are packed in Instruction::kinds (a in the low two bits,
+// b in the next two), and c is the BinaryOp.
+//   COMPARE_JUMP: load a; load b; BINARY c; POP_JUMP_IF_FALSE
+//   UPDATE:       load a; load b; BINARY c; store a   (c is +, - or *)
+enum SlotKind : uint8_t { LOCAL_SLOT, GLOBAL_SLOT, CONST_SLOT };
+
+// Builtins up to BOOL are resolved at compile time and win over user
+// functions of the same name. Library builtins, from FIRST_LIBRARY on, are
+// called like user functions and used only when no user function of the
+// name is defined at the time of the call, so scripts may define their own.
+enum class Builtin : uint8_t { PRINT, INT, FLOAT, STR, BOOL, FACTORIAL, BUILTIN_COUNT };
+const Builtin FIRST_LIBRARY = Builtin::FACTORIAL;
+
+// The builtin called name, or BUILTIN_COUNT if there is none. Library
+// builtins are only found if library is set.
+Builtin findBuiltin(const std::string &name, bool library = false);
+const char *builtinName(Builtin builtin);
+
+struct Instruction {
+  Op op;
+  // extra operands of the fused instructions
+  uint8_t c = 0;
+  uint8_t kinds = 0;
+  uint8_t pad = 0;
+  int32_t a = 0;
+  int32_t b = 0;
+};
+
+// A user function call: the callee's name and, for each argument, -1 if it
+// is positional or the index into Module::names of its keyword.
+struct CallSite {
+  int32_t name = 0;
+  std::vector<int32_t> keywords;
+};
+
+// A compiled function body, or the module body (codes[0]).
+struct CodeObject {
+  std::string name;
+  // locals[0..numParams) are the parameters, the rest are assigned names
+  std::vector<std::string> locals;
+  uint32_t numParams = 0;
+  // the last numDefaults parameters have default values
+  uint32_t numDefaults = 0;
+  // the result depends only on the parameters (see PurityAnalysis)
+  bool pure = false;
+
+  // instructions and their source lines, either in owned storage or in a
+  // mapped cache file (see ScriptCache)
+  const Instruction *code = nullptr;
+  const int32_t *lines = nullptr;
+  uint32_t size = 0;
+
+  std::vector<Instruction> ownedCode;
+  std::vector<int32_t> ownedLines;
+
+  // Point code and lines at the owned storage once it is complete.
+  void seal();
+};
+
+struct Module {
+  std::vector<Value> constants;
+  std::vector<std::string> globals;
+  // interned: a name has one index, so the VM can key tables by it
+  std::vector<std::string> names;
+  std::vector<CallSite> callSites;
+  std::vector<CodeObject> codes;
+
+  // keeps a mapped cache file alive while code points into it
+  std::shared_ptr<const void> backing;
+
+  // Check that every operand indexes something that exists, so a damaged
+  // cache file cannot make the VM read out of bounds.
+  bool validate() const;
+};
+
+#endif//PYTHON_INTERPRETER_BYTECODE_H
@@ -0,0 +1,536 @@
+#include "Compiler.h"
+#include "PurityAnalysis.h"
+#include <stdexcept>
+
+std::unique_ptr<Module> Compiler::compile(const ast::Program &program) {
+  auto result = std::make_unique<Module>();
+  module = result.get();
+  pureFunctions = PurityAnalysis().run(program);
+  module->codes.emplace_back();
+
+  Scope top;
+  top.code.name = "<module>";
+  scope = &top;
+  for (auto stmt : program.body) {
+    top.statementExits.clear();
+    compileStmt(stmt);
+    for (int exit : top.statementExits) {
+      patch(exit, here());
+    }
+  }
+  emit(Op::LOAD_CONST, constant(Value(None{})));
+  emit(Op::RETURN_VALUE);
+
+  module->codes[0] = std::move(top.code);
+  module->codes[0].seal();
+  scope = nullptr;
+  module = nullptr;
+  return result;
+}
+
+int Compiler::emit(Op op, int a, int b) {
+  Instruction ins;
+  ins.op = op;
+  ins.a = a;
+  ins.b = b;
+  scope->code.ownedCode.push_back(ins);
+  scope->code.ownedLines.push_back(line);
+  return (int)scope->code.ownedCode.size() - 1;
+}
+
+void Compiler::emitBinary(BinaryOp op) {
+  emit(Op::BINARY, (int)op, scope->binarySites++);
+}
+
+bool Compiler::slotOf(const ast::Expr *expr, int &kind, int &index) {
+  if (expr->kind == ast::Expr::NAME) {
+    // the slot compileLoad reads first
+    const std::string &name = static_cast<const ast::NameExpr *>(expr)->name;
+    auto it = scope->locals.find(name);
+    if (scope->isFunction && it != scope->locals.end()) {
+      kind = LOCAL_SLOT;
+      index = it->second;
+    } else {
+      kind = GLOBAL_SLOT;
+      index = globalSlot(name);
+    }
+    return true;
+  }
+  if (expr->kind == ast::Expr::CONSTANT) {
+    const Value &value = static_cast<const ast::ConstantExpr *>(expr)->value;
+    if (value.type() != Value::INT) return false;
+    kind = CONST_SLOT;
+    index = constant(value);
+    return true;
+  }
+  return false;
+}
+
+int Compiler::emitFused(Op op, BinaryOp binary, int leftKind, int left, int rightKind, int right) {
+  int at = emit(op, left, right);
+  scope->code.ownedCode[at].c = (uint8_t)binary;
+  scope->code.ownedCode[at].kinds = (uint8_t)(leftKind | rightKind << 2);
+  return at;
+}
+
+void Compiler::checkFused(int at) {
+  if (at >= 0 && here() - at != 5) {
+    scope->code.ownedCode[at] = Instruction();
+  }
+}
+
+void Compiler::compileUpdate(const std::string &name, BinaryOp op, const ast::Expr *operand) {
+  int fused = -1, kind, index;
+  bool arithmetic = op == BinaryOp::ADD || op == BinaryOp::SUB || op == BinaryOp::MUL;
+  if (arithmetic && slotOf(operand, kind, index)) {
+    // the slot compileStore writes to, which compileLoad also reads first
+    int target = scope->isFunction ? scope->locals.at(name) : globalSlot(name);
+    fused = emitFused(Op::UPDATE, op, scope->isFunction ? LOCAL_SLOT : GLOBAL_SLOT, target, kind, index);
+  }
+  compileLoad(name);
+  compileExpr(operand);
+  emitBinary(op);
+  compileStore(name);
+  checkFused(fused);
+}
+
+int Compiler::here() const {
+  return (int)scope->code.ownedCode.size();
+}
+
+void Compiler::patch(int at, int target) {
+  scope->code.ownedCode[at].a = target;
+}
+
+int Compiler::constant(const Value &value) {
+  int *cached = nullptr;
+  if (value.type() == Value::NONE) cached = &noneConstant;
+  if (value.type() == Value::BOOL) cached = value.asBool() ? &trueConstant : &falseConstant;
+  if (cached && *cached >= 0) return *cached;
+  // equal ints and strings share one entry; floats are left alone, since
+  // 0.0 and -0.0 compare equal but print differently
+  std::string key;
+  if (value.type() == Value::INT) {
+    key = "i";
+    value.asInt().append_to(key);
+  } else if (value.type() == Value::STR) {
+    key = "s" + value.asStr();
+  }
+  if (!key.empty()) {
+    auto it = constantIndex.find(key);
+    if (it != constantIndex.end()) return it->second;
+  }
+  module->constants.push_back(value);
+  int index = (int)module->constants.size() - 1;
+  if (cached) *cached = index;
+  if (!key.empty()) constantIndex.emplace(std::move(key), index);
+  return index;
+}
+
+int Compiler::globalSlot(const std::string &name) {
+  auto it = globalSlots.find(name);
+  if (it != globalSlots.end()) return it->second;
+  module->globals.push_back(name);
+  int index = (int)module->globals.size() - 1;
+  globalSlots.emplace(name, index);
+  return index;
+}
+
+int Compiler::nameSlot(const std::string &name) {
+  auto it = nameSlots.find(name);
+  if (it != nameSlots.end()) return it->second;
+  module->names.push_back(name);
+  int index = (int)module->names.size() - 1;
+  nameSlots.emplace(name, index);
+  return index;
+}
+
+void Compiler::collectLocals(const ast::Suite &suite, Scope &target) {
+  auto add = [&target](const std::string &name) {
+    if (target.locals.count(name)) return;
+    target.locals.emplace(name, (int)target.code.locals.size());
+    target.code.locals.push_back(name);
+  };
+  for (auto stmt : suite) {
+    switch (stmt->kind) {
+      case ast::Stmt::ASSIGN:
+        for (auto &targets : static_cast<const ast::AssignStmt *>(stmt)->targets) {
+          for (auto &name : targets) add(name);
+        }
+        break;
+      case ast::Stmt::AUGASSIGN:
+        for (auto &name : static_cast<const ast::AugAssignStmt *>(stmt)->targets) add(name);
+        break;
+      case ast::Stmt::IF: {
+        auto ifStmt = static_cast<const ast::IfStmt *>(stmt);
+        for (auto &body : ifStmt->bodies) collectLocals(body, target);
+        collectLocals(ifStmt->orelse, target);
+        break;
+      }
+      case ast::Stmt::WHILE:
+        collectLocals(static_cast<const ast::WhileStmt *>(stmt)->body, target);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+void Compiler::compileFunction(const ast::FuncDef &def) {
+  // default values are evaluated once, in the defining scope
+  uint32_t numDefaults = 0;
+  for (auto &param : def.parameters) {
+    if (param.defaultValue) {
+      compileExpr(param.defaultValue);
+      numDefaults++;
+    }
+  }
+  int index = (int)module->codes.size();
+  module->codes.emplace_back();
+
+  Scope function;
+  function.isFunction = true;
+  function.code.name = def.name;
+  for (auto &param : def.parameters) {
+    function.locals.emplace(param.name, (int)function.code.locals.size());
+    function.code.locals.push_back(param.name);
+  }
+  function.code.numParams = def.parameters.size();
+  function.code.numDefaults = numDefaults;
+  function.code.pure = pureFunctions.count(&def) > 0;
+  collectLocals(def.body, function);
+
+  Scope *enclosing = scope;
+  int enclosingLine = line;
+  scope = &function;
+  compileSuite(def.body);
+  emit(Op::LOAD_CONST, constant(Value(None{})));
+  emit(Op::RETURN_VALUE);
+  scope = enclosing;
+  line = enclosingLine;
+
+  module->codes[index] = std::move(function.code);
+  module->codes[index].seal();
+  emit(Op::DEF_FUNCTION, index, nameSlot(def.name));
+}
+
+void Compiler::compileSuite(const ast::Suite &suite) {
+  for (auto stmt : suite) {
+    compileStmt(stmt);
+  }
+}
+
+void Compiler::compileStmt(const ast::Stmt *stmt) {
+  line = stmt->line;
+  switch (stmt->kind) {
+    case ast::Stmt::EXPR:
+      for (auto value : static_cast<const ast::ExprStmt *>(stmt)->values) {
+        compileExpr(value);
+        emit(Op::POP_TOP);
+      }
+      break;
+    case ast::Stmt::ASSIGN:
+      compileAssign(static_cast<const ast::AssignStmt *>(stmt));
+      break;
+    case ast::Stmt::AUGASSIGN:
+      compileAugAssign(static_cast<const ast::AugAssignStmt *>(stmt));
+      break;
+    case ast::Stmt::IF:
+      compileIf(static_cast<const ast::IfStmt *>(stmt));
+      break;
+    case ast::Stmt::WHILE:
+      compileWhile(static_cast<const ast::WhileStmt *>(stmt));
+      break;
+    case ast::Stmt::FUNCDEF:
+      compileFunction(*static_cast<const ast::FuncDef *>(stmt));
+      break;
+    case ast::Stmt::RETURN:
+      compileReturn(static_cast<const ast::ReturnStmt *>(stmt));
+      break;
+    case ast::Stmt::BREAK:
+      compileLoopExit(true);
+      break;
+    case ast::Stmt::CONTINUE:
+      compileLoopExit(false);
+      break;
+  }
+}
+
+void Compiler::compileAssign(const ast::AssignStmt *stmt) {
+  // a call may return a tuple, which has to be spliced into the values
+  bool simple = stmt->targets.size() == 1 && stmt->targets[0].size() == 1 && stmt->values.size() == 1 &&
+                stmt->values[0]->kind != ast::Expr::CALL;
+  if (simple) {
+    const std::string &name = stmt->targets[0][0];
+    auto value = stmt->values[0];
+    if (value->kind == ast::Expr::BINARY) {
+      auto binary = static_cast<const ast::BinaryExpr *>(value);
+      if (binary->left->kind == ast::Expr::NAME && static_cast<const ast::NameExpr *>(binary->left)->name == name) {
+        compileUpdate(name, binary->op, binary->right);
+        return;
+      }
+    }
+    compileExpr(value);
+    compileStore(name);
+    return;
+  }
+  for (auto value : stmt->values) {
+    compileExpr(value);
+  }
+  emit(Op::BUILD_TUPLE, stmt->values.size());
+  for (size_t i = 0; i < stmt->targets.size(); ++i) {
+    if (i + 1 < stmt->targets.size()) emit(Op::DUP_TOP);
+    emit(Op::UNPACK, stmt->targets[i].size());
+    for (auto &name : stmt->targets[i]) {
+      compileStore(name);
+    }
+  }
+}
+
+void Compiler::compileAugAssign(const ast::AugAssignStmt *stmt) {
+  bool simple = stmt->targets.size() == 1 && stmt->values.size() == 1 && stmt->values[0]->kind != ast::Expr::CALL;
+  if (simple) {
+    compileUpdate(stmt->targets[0], stmt->op, stmt->values[0]);
+    return;
+  }
+  for (auto value : stmt->values) {
+    compileExpr(value);
+  }
+  emit(Op::BUILD_TUPLE, stmt->values.size());
+  emit(Op::UNPACK, stmt->targets.size());
+  for (auto &name : stmt->targets) {
+    compileLoad(name);
+    emit(Op::ROT_TWO);
+    emitBinary(stmt->op);
+    compileStore(name);
+  }
+}
+
+// condition; POP_JUMP_IF_FALSE, returning the index of the jump. A single
+// comparison of two names or int constants gets a fused COMPARE_JUMP.
+int Compiler::compileCondition(const ast::Expr *condition) {
+  int fused = -1;
+  if (condition->kind == ast::Expr::COMPARE) {
+    auto compare = static_cast<const ast::CompareExpr *>(condition);
+    int leftKind, left, rightKind, right;
+    if (compare->ops.size() == 1 && slotOf(compare->operands[0], leftKind, left) &&
+        slotOf(compare->operands[1], rightKind, right)) {
+      fused = emitFused(Op::COMPARE_JUMP, compare->ops[0], leftKind, left, rightKind, right);
+    }
+  }
+  compileExpr(condition);
+  int jump = emit(Op::POP_JUMP_IF_FALSE);
+  checkFused(fused);
+  return jump;
+}
+
+void Compiler::compileIf(const ast::IfStmt *stmt) {
+  std::vector<int> ends;
+  for (size_t i = 0; i < stmt->conditions.size(); ++i) {
+    int next = compileCondition(stmt->conditions[i]);
+    compileSuite(stmt->bodies[i]);
+    if (i + 1 < stmt->conditions.size() || stmt->hasElse) {
+      ends.push_back(emit(Op::JUMP));
+    }
+    patch(next, here());
+  }
+  if (stmt->hasElse) {
+    compileSuite(stmt->orelse);
+  }
+  for (int end : ends) {
+    patch(end, here());
+  }
+}
+
+void Compiler::compileWhile(const ast::WhileStmt *stmt) {
+  scope->loops.push_back(Loop{here(), {}});
+  line = stmt->line;
+  // a condition folded to a true constant needs no test: while True
+  int exit = -1;
+  if (stmt->condition->kind != ast::Expr::CONSTANT || !toBool(static_cast<const ast::ConstantExpr *>(stmt->condition)->value)) {
+    exit = compileCondition(stmt->condition);
+  }
+  compileSuite(stmt->body);
+  line = stmt->line;
+  emit(Op::JUMP, scope->loops.back().start);
+  if (exit >= 0) patch(exit, here());
+  for (int jump : scope->loops.back().breaks) {
+    patch(jump, here());
+  }
+  scope->loops.pop_back();
+}
+
+void Compiler::compileReturn(const ast::ReturnStmt *stmt) {
+  if (!scope->isFunction) {
+    // evaluated for its side effects, then the top-level statement ends
+    for (auto value : stmt->values) {
+      compileExpr(value);
+      emit(Op::POP_TOP);
+    }
+    scope->statementExits.push_back(emit(Op::JUMP));
+    return;
+  }
+  if (stmt->values.empty()) {
+    emit(Op::LOAD_CONST, constant(Value(None{})));
+  } else {
+    for (auto value : stmt->values) {
+      compileExpr(value);
+    }
+    if (stmt->values.size() > 1) {
+      emit(Op::BUILD_TUPLE, stmt->values.size());
+    }
+  }
+  emit(Op::RETURN_VALUE);
+}
+
+void Compiler::compileLoopExit(bool isBreak) {
+  if (!scope->loops.empty()) {
+    if (isBreak) {
+      scope->loops.back().breaks.push_back(emit(Op::JUMP));
+    } else {
+      emit(Op::JUMP, scope->loops.back().start);
+    }
+    return;
+  }
+  if (scope->isFunction) {
+    // the Flow escapes the function body, which then returns None
+    emit(Op::LOAD_CONST, constant(Value(None{})));
+    emit(Op::RETURN_VALUE);
+    return;
+  }
+  scope->statementExits.push_back(emit(Op::JUMP));
+}
+
+void Compiler::compileLoad(const std::string &name) {
+  if (scope->isFunction) {
+    auto it = scope->locals.find(name);
+    if (it != scope->locals.end()) {
+      emit(Op::LOAD_NAME, it->second, globalSlot(name));
+      return;
+    }
+  }
+  emit(Op::LOAD_GLOBAL, globalSlot(name));
+}
+
+void Compiler::compileStore(const std::string &name) {
+  if (scope->isFunction) {
+    emit(Op::STORE_NAME, scope->locals.at(name), globalSlot(name));
+  } else {
+    emit(Op::STORE_GLOBAL, globalSlot(name));
+  }
+}
+
+void Compiler::compileExpr(const ast::Expr *expr) {
+  switch (expr->kind) {
+    case ast::Expr::NAME:
+      compileLoad(static_cast<const ast::NameExpr *>(expr)->name);
+      break;
+    case ast::Expr::CONSTANT:
+      emit(Op::LOAD_CONST, constant(static_cast<const ast::ConstantExpr *>(expr)->value));
+      break;
+    case ast::Expr::FSTRING:
+      compileFString(static_cast<const ast::FStringExpr *>(expr));
+      break;
+    case ast::Expr::UNARY: {
+      auto unary = static_cast<const ast::UnaryExpr *>(expr);
+      compileExpr(unary->operand);
+      if (unary->op == ast::UnaryExpr::PLUS) emit(Op::UNARY_PLUS);
+      else if (unary->op == ast::UnaryExpr::MINUS) emit(Op::UNARY_MINUS);
+      else emit(Op::NOT);
+      break;
+    }
+    case ast::Expr::BINARY: {
+      auto binary = static_cast<const ast::BinaryExpr *>(expr);
+      compileExpr(binary->left);
+      compileExpr(binary->right);
+      emitBinary(binary->op);
+      break;
+    }
+    case ast::Expr::COMPARE:
+      compileCompare(static_cast<const ast::CompareExpr *>(expr));
+      break;
+    case ast::Expr::BOOLEAN:
+      compileBoolean(static_cast<const ast::BooleanExpr *>(expr));
+      break;
+    case ast::Expr::CALL:
+      compileCall(static_cast<const ast::CallExpr *>(expr));
+      break;
+  }
+}
+
+// a < b < c evaluates b once and stops at the first false comparison:
+//   a; b; DUP_TOP; ROT_THREE; BINARY <; JUMP_IF_FALSE_OR_POP cleanup;
+//   c; BINARY <; JUMP end; cleanup: ROT_TWO; POP_TOP; end:
+void Compiler::compileCompare(const ast::CompareExpr *expr) {
+  size_t count = expr->ops.size();
+  compileExpr(expr->operands[0]);
+  std::vector<int> cleanups;
+  for (size_t i = 0; i < count; ++i) {
+    compileExpr(expr->operands[i + 1]);
+    if (i + 1 < count) {
+      emit(Op::DUP_TOP);
+      emit(Op::ROT_THREE);
+    }
+    emitBinary(expr->ops[i]);
+    if (i + 1 < count) {
+      cleanups.push_back(emit(Op::JUMP_IF_FALSE_OR_POP));
+    }
+  }
+  if (cleanups.empty()) return;
+  int end = emit(Op::JUMP);
+  for (int cleanup : cleanups) {
+    patch(cleanup, here());
+  }
+  emit(Op::ROT_TWO);
+  emit(Op::POP_TOP);
+  patch(end, here());
+}
+
+void Compiler::compileBoolean(const ast::BooleanExpr *expr) {
+  std::vector<int> ends;
+  for (size_t i = 0; i < expr->operands.size(); ++i) {
+    compileExpr(expr->operands[i]);
+    emit(Op::TO_BOOL);
+    if (i + 1 < expr->operands.size()) {
+      ends.push_back(emit(expr->isAnd ? Op::JUMP_IF_FALSE_OR_POP : Op::JUMP_IF_TRUE_OR_POP));
+    }
+  }
+  for (int end : ends) {
+    patch(end, here());
+  }
+}
+
+void Compiler::compileCall(const ast::CallExpr *expr) {
+  for (auto arg : expr->args) {
+    compileExpr(arg);
+  }
+  Builtin builtin = findBuiltin(expr->name);
+  if (builtin != Builtin::BUILTIN_COUNT) {
+    emit(Op::CALL_BUILTIN, (int)builtin, expr->args.size());
+    return;
+  }
+  CallSite site;
+  site.name = nameSlot(expr->name);
+  for (auto &keyword : expr->keywords) {
+    site.keywords.push_back(keyword.empty() ? -1 : nameSlot(keyword));
+  }
+  module->callSites.push_back(std::move(site));
+  emit(Op::CALL, (int)module->callSites.size() - 1);
+}
+
+void Compiler::compileFString(const ast::FStringExpr *expr) {
+  int count = 0;
+  for (size_t i = 0; i < expr->literals.size(); ++i) {
+    if (!expr->literals[i].empty()) {
+      emit(Op::LOAD_CONST, constant(Value(expr->literals[i])));
+      count++;
+    }
+    if (i < expr->slots.size()) {
+      for (auto value : expr->slots[i]) {
+        compileExpr(value);
+        count++;
+      }
+    }
+  }
+  emit(Op::BUILD_STRING, count);
+}
@@ -0,0 +1,92 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_COMPILER_H
+#define PYTHON_INTERPRETER_COMPILER_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Ast.h"
+#include "Bytecode.h"
+
+// Compiles the AST of a whole script into a Module for the VM.
+// Name resolution follows EvalVisitor: inside a function a name that is
+// assigned may live either in the local frame or, if a global of that name
+// already exists, in the global scope, so such names get both a local slot
+// and a global slot; names that are only read go straight to the globals.
+class Compiler {
+public:
+  std::unique_ptr<Module> compile(const ast::Program &program);
+
+private:
+  struct Loop {
+    int start;
+    std::vector<int> breaks;
+  };
+
+  // state of the code object being compiled
+  struct Scope {
+    CodeObject code;
+    bool isFunction = false;
+    std::unordered_map<std::string, int> locals;
+    std::vector<Loop> loops;
+    // module level only: break/continue/return outside a loop jump to the
+    // end of the enclosing top-level statement, like EvalVisitor ignoring
+    // the Flow that reaches visitFile_input
+    std::vector<int> statementExits;
+    // BINARY instructions emitted so far; each gets its own inline cache
+    int binarySites = 0;
+  };
+
+  Module *module = nullptr;
+  Scope *scope = nullptr;
+  int line = 0;
+  std::unordered_map<std::string, int> globalSlots;
+  std::unordered_map<std::string, int> nameSlots;
+  int noneConstant = -1, trueConstant = -1, falseConstant = -1;
+  // type tag + value text -> constant index, for ints and strings
+  std::unordered_map<std::string, int> constantIndex;
+  std::unordered_set<const ast::FuncDef *> pureFunctions;
+
+  int emit(Op op, int a = 0, int b = 0);
+  void emitBinary(BinaryOp op);
+
+  // fused instructions (see Bytecode.h)
+  bool slotOf(const ast::Expr *expr, int &kind, int &index);
+  int emitFused(Op op, BinaryOp binary, int leftKind, int left, int rightKind, int right);
+  // Turn the fused instruction at into a NOP unless exactly the four
+  // generic instructions it stands for were emitted after it.
+  void checkFused(int at);
+  // name op= operand, or name = name op operand
+  void compileUpdate(const std::string &name, BinaryOp op, const ast::Expr *operand);
+  int here() const;
+  void patch(int at, int target);
+
+  int constant(const Value &value);
+  int globalSlot(const std::string &name);
+  int nameSlot(const std::string &name);
+
+  void collectLocals(const ast::Suite &suite, Scope &target);
+  void compileFunction(const ast::FuncDef &def);
+
+  void compileSuite(const ast::Suite &suite);
+  void compileStmt(const ast::Stmt *stmt);
+  void compileAssign(const ast::AssignStmt *stmt);
+  void compileAugAssign(const ast::AugAssignStmt *stmt);
+  int compileCondition(const ast::Expr *condition);
+  void compileIf(const ast::IfStmt *stmt);
+  void compileWhile(const ast::WhileStmt *stmt);
+  void compileReturn(const ast::ReturnStmt *stmt);
+  void compileLoopExit(bool isBreak);
+  void compileLoad(const std::string &name);
+  void compileStore(const std::string &name);
+
+  void compileExpr(const ast::Expr *expr);
+  void compileCompare(const ast::CompareExpr *expr);
+  void compileBoolean(const ast::BooleanExpr *expr);
+  void compileCall(const ast::CallExpr *expr);
+  void compileFString(const ast::FStringExpr *expr);
+};
+
+#endif//PYTHON_INTERPRETER_COMPILER_H
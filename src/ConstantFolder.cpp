@@ -0,0 +1,248 @@
+#include "ConstantFolder.h"
+#include "Bytecode.h"
+#include <exception>
+
+static const Value *constantValue(const ast::Expr *expr) {
+  if (expr->kind != ast::Expr::CONSTANT) return nullptr;
+  return &static_cast<const ast::ConstantExpr *>(expr)->value;
+}
+
+// Values whose str() does not depend on run-time settings.
+static bool hasStableText(const Value &value) {
+  switch (value.type()) {
+    case Value::NONE:
+    case Value::BOOL:
+    case Value::INT:
+    case Value::STR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Whether left op right is small enough to keep in the constant pool.
+static bool withinLimits(BinaryOp op, const Value &left, const Value &right) {
+  bool leftStr = left.type() == Value::STR, rightStr = right.type() == Value::STR;
+  if (op == BinaryOp::ADD && leftStr && rightStr) {
+    return left.asStr().size() + right.asStr().size() <= ConstantFolder::MAX_STRING;
+  }
+  if (op == BinaryOp::MUL && leftStr != rightStr) {
+    const Value &str = leftStr ? left : right, &times = leftStr ? right : left;
+    double count = 1;
+    if (times.type() == Value::INT) count = times.asInt().to_double();
+    else if (times.type() != Value::BOOL) return true;
+    return count <= 0 || count * str.asStr().size() <= ConstantFolder::MAX_STRING;
+  }
+  return true;
+}
+
+void ConstantFolder::fold(ast::Program &target) {
+  program = &target;
+  foldSuite(target.body);
+  program = nullptr;
+}
+
+void ConstantFolder::foldSuite(const ast::Suite &suite) {
+  for (auto stmt : suite) {
+    foldStmt(stmt);
+  }
+}
+
+void ConstantFolder::foldStmt(ast::Stmt *stmt) {
+  switch (stmt->kind) {
+    case ast::Stmt::EXPR:
+      foldExprs(static_cast<ast::ExprStmt *>(stmt)->values);
+      break;
+    case ast::Stmt::ASSIGN:
+      foldExprs(static_cast<ast::AssignStmt *>(stmt)->values);
+      break;
+    case ast::Stmt::AUGASSIGN:
+      foldExprs(static_cast<ast::AugAssignStmt *>(stmt)->values);
+      break;
+    case ast::Stmt::IF: {
+      auto ifStmt = static_cast<ast::IfStmt *>(stmt);
+      foldExprs(ifStmt->conditions);
+      for (auto &body : ifStmt->bodies) {
+        foldSuite(body);
+      }
+      foldSuite(ifStmt->orelse);
+      break;
+    }
+    case ast::Stmt::WHILE: {
+      auto whileStmt = static_cast<ast::WhileStmt *>(stmt);
+      whileStmt->condition = foldExpr(whileStmt->condition);
+      foldSuite(whileStmt->body);
+      break;
+    }
+    case ast::Stmt::FUNCDEF: {
+      auto def = static_cast<ast::FuncDef *>(stmt);
+      for (auto &param : def->parameters) {
+        if (param.defaultValue) param.defaultValue = foldExpr(param.defaultValue);
+      }
+      foldSuite(def->body);
+      break;
+    }
+    case ast::Stmt::RETURN:
+      foldExprs(static_cast<ast::ReturnStmt *>(stmt)->values);
+      break;
+    case ast::Stmt::BREAK:
+    case ast::Stmt::CONTINUE:
+      break;
+  }
+}
+
+void ConstantFolder::foldExprs(const ast::List<ast::Expr *> &exprs) {
+  for (auto &expr : exprs) {
+    expr = foldExpr(expr);
+  }
+}
+
+ast::Expr *ConstantFolder::foldExpr(ast::Expr *expr) {
+  switch (expr->kind) {
+    case ast::Expr::NAME:
+    case ast::Expr::CONSTANT:
+      return expr;
+
+    case ast::Expr::FSTRING:
+      return foldFString(static_cast<ast::FStringExpr *>(expr));
+
+    case ast::Expr::UNARY: {
+      auto unary = static_cast<ast::UnaryExpr *>(expr);
+      unary->operand = foldExpr(unary->operand);
+      const Value *operand = constantValue(unary->operand);
+      if (!operand) return expr;
+      try {
+        if (unary->op == ast::UnaryExpr::PLUS) return constant(expr->line, unaryPlus(*operand));
+        if (unary->op == ast::UnaryExpr::MINUS) return constant(expr->line, unaryMinus(*operand));
+        return constant(expr->line, Value(!toBool(*operand)));
+      } catch (const std::exception &) {
+        return expr;
+      }
+    }
+
+    case ast::Expr::BINARY: {
+      auto binary = static_cast<ast::BinaryExpr *>(expr);
+      binary->left = foldExpr(binary->left);
+      binary->right = foldExpr(binary->right);
+      const Value *left = constantValue(binary->left), *right = constantValue(binary->right);
+      if (!left || !right || !withinLimits(binary->op, *left, *right)) return expr;
+      try {
+        return constant(expr->line, binaryOp(binary->op, *left, *right));
+      } catch (const std::exception &) {
+        return expr;
+      }
+    }
+
+    case ast::Expr::COMPARE: {
+      auto compare = static_cast<ast::CompareExpr *>(expr);
+      foldExprs(compare->operands);
+      for (auto operand : compare->operands) {
+        if (!constantValue(operand)) return expr;
+      }
+      try {
+        Value result;
+        for (size_t i = 0; i < compare->ops.size(); ++i) {
+          result = binaryOp(compare->ops[i], *constantValue(compare->operands[i]), *constantValue(compare->operands[i + 1]));
+          if (!toBool(result)) break;
+        }
+        return constant(expr->line, std::move(result));
+      } catch (const std::exception &) {
+        return expr;
+      }
+    }
+
+    case ast::Expr::BOOLEAN: {
+      // a constant that does not decide the result can be dropped; one that
+      // does ends the list, since nothing after it is ever evaluated
+      auto boolean = static_cast<ast::BooleanExpr *>(expr);
+      foldExprs(boolean->operands);
+      std::vector<ast::Expr *> kept;
+      for (auto operand : boolean->operands) {
+        const Value *value = constantValue(operand);
+        if (!value) {
+          kept.push_back(operand);
+          continue;
+        }
+        if (toBool(*value) == boolean->isAnd) continue;
+        if (kept.empty()) return constant(expr->line, Value(!boolean->isAnd));
+        kept.push_back(operand);
+        break;
+      }
+      if (kept.empty()) return constant(expr->line, Value(boolean->isAnd));
+      if (kept.size() != boolean->operands.size()) {
+        boolean->operands = program->list(std::move(kept));
+      }
+      return expr;
+    }
+
+    case ast::Expr::CALL:
+      return foldCall(static_cast<ast::CallExpr *>(expr));
+  }
+  return expr;
+}
+
+// Slots holding only constants are merged into the surrounding literals.
+ast::Expr *ConstantFolder::foldFString(ast::FStringExpr *expr) {
+  for (auto &slot : expr->slots) {
+    foldExprs(slot);
+  }
+  std::vector<std::string> literals{expr->literals[0]};
+  std::vector<ast::List<ast::Expr *>> slots;
+  for (size_t i = 0; i < expr->slots.size(); ++i) {
+    bool stable = true;
+    for (auto value : expr->slots[i]) {
+      const Value *folded = constantValue(value);
+      stable = stable && folded && hasStableText(*folded);
+    }
+    if (stable) {
+      for (auto value : expr->slots[i]) {
+        appendStr(literals.back(), *constantValue(value));
+      }
+      literals.back() += expr->literals[i + 1];
+    } else {
+      slots.push_back(expr->slots[i]);
+      literals.push_back(expr->literals[i + 1]);
+    }
+  }
+  if (slots.empty()) {
+    return constant(expr->line, Value(std::move(literals[0])));
+  }
+  if (slots.size() != expr->slots.size()) {
+    expr->literals = program->list(std::move(literals));
+    expr->slots = program->list(std::move(slots));
+  }
+  return expr;
+}
+
+// int(), float(), str() and bool() of a constant; builtins always win over
+// user functions of the same name, as in Compiler::compileCall.
+ast::Expr *ConstantFolder::foldCall(ast::CallExpr *expr) {
+  foldExprs(expr->args);
+  Builtin builtin = findBuiltin(expr->name);
+  if (builtin == Builtin::BUILTIN_COUNT || builtin == Builtin::PRINT || expr->args.size() != 1) return expr;
+  const Value *arg = constantValue(expr->args[0]);
+  if (!arg || !expr->keywords[0].empty()) return expr;
+  try {
+    switch (builtin) {
+      case Builtin::INT:
+        return constant(expr->line, Value(toInt(*arg)));
+      case Builtin::FLOAT:
+        return constant(expr->line, Value(toDouble(*arg)));
+      case Builtin::STR:
+        if (!hasStableText(*arg)) return expr;
+        return constant(expr->line, Value(toStr(*arg)));
+      case Builtin::BOOL:
+        return constant(expr->line, Value(toBool(*arg)));
+      default:
+        return expr;
+    }
+  } catch (const std::exception &) {
+    return expr;
+  }
+}
+
+ast::Expr *ConstantFolder::constant(int line, Value &&value) {
+  auto expr = program->make<ast::ConstantExpr>(line);
+  expr->value = std::move(value);
+  return expr;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_CONSTANTFOLDER_H
+#define PYTHON_INTERPRETER_CONSTANTFOLDER_H
+
+#include "Ast.h"
+
+// Replaces constant subexpressions of a Program with their values before it
+// is compiled, so that e.g. 10000 * 10000, -1 or "a" + "b" inside a loop
+// become a single LOAD_CONST. Values are computed with the same functions
+// the VM uses, so folding never changes what a script prints:
+// an expression whose evaluation would raise is left alone to raise at run
+// time, and nothing that formats a float as text is folded, since the float
+// format is chosen at run time and compiled modules are cached.
+class ConstantFolder {
+public:
+  // Longest string a fold may produce; "-" * 100000000 stays a multiply.
+  static const size_t MAX_STRING = 4096;
+
+  void fold(ast::Program &program);
+
+private:
+  ast::Program *program = nullptr;
+
+  void foldSuite(const ast::Suite &suite);
+  void foldStmt(ast::Stmt *stmt);
+  void foldExprs(const ast::List<ast::Expr *> &exprs);
+  // Fold expr in place and return the folded expression.
+  ast::Expr *foldExpr(ast::Expr *expr);
+  ast::Expr *foldFString(ast::FStringExpr *expr);
+  ast::Expr *foldCall(ast::CallExpr *expr);
+  ast::Expr *constant(int line, Value &&value);
+};
+
+#endif//PYTHON_INTERPRETER_CONSTANTFOLDER_H
@@ -0,0 +1,104 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_COW_H
+#define PYTHON_INTERPRETER_COW_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include "Memory.h"
+#include "Pool.h"
+
+// Heap bytes a payload holds outside its box, charged to the memory budget
+// while the box lives. int2048 limbs are charged by their own allocator.
+template <typename T>
+struct PayloadMemory {
+  static const MemoryBudget::Category category = MemoryBudget::VALUES;
+  static size_t bytes(const T &) { return 0; }
+};
+template <>
+struct PayloadMemory<std::string> {
+  static const MemoryBudget::Category category = MemoryBudget::STRINGS;
+  static size_t bytes(const std::string &s) { return s.capacity() > 15 ? s.capacity() + 1 : 0; }
+};
+
+// A reference-counted, copy-on-write box: copies share one payload, and
+// mutate() gives a private copy first if the payload is shared. The count
+// is not atomic; values belong to the interpreter thread. A moved-from box
+// may only be assigned to or destroyed. Boxes come from valuePool().
+template <typename T>
+class Cow {
+public:
+  explicit Cow(const T &value) : box(make(value)) {}
+  explicit Cow(T &&value) : box(make(std::move(value))) {}
+  Cow(const Cow &other) : box(other.box) { box->refs++; }
+  Cow(Cow &&other) noexcept : box(other.box) { other.box = nullptr; }
+  ~Cow() { release(); }
+
+  Cow &operator=(const Cow &other) {
+    other.box->refs++;
+    release();
+    box = other.box;
+    return *this;
+  }
+  Cow &operator=(Cow &&other) noexcept {
+    if (this != &other) {
+      release();
+      box = other.box;
+      other.box = nullptr;
+    }
+    return *this;
+  }
+
+  const T &get() const { return box->value; }
+  T &mutate() {
+    if (box->refs > 1) {
+      box->refs--;
+      box = make(box->value);
+    }
+    return box->value;
+  }
+  bool shared() const { return box->refs > 1; }
+  // Bring the payload's charge up to date after an update through mutate()
+  // changed its size. Throws MemoryError if the growth does not fit.
+  void recharge() {
+    size_t bytes = PayloadMemory<T>::bytes(box->value);
+    if (bytes > box->charged) {
+      memoryBudget().charge(PayloadMemory<T>::category, bytes - box->charged);
+    } else {
+      memoryBudget().release(PayloadMemory<T>::category, box->charged - bytes);
+    }
+    box->charged = bytes;
+  }
+
+private:
+  struct Box {
+    T value;
+    uint32_t refs;
+    size_t charged;
+  };
+  Box *box;
+
+  template <typename U>
+  static Box *make(U &&value) {
+    void *memory = valuePool().allocate(sizeof(Box));
+    size_t charged = PayloadMemory<T>::bytes(value);
+    if (charged) {
+      try {
+        memoryBudget().charge(PayloadMemory<T>::category, charged);
+      } catch (...) {
+        valuePool().deallocate(memory, sizeof(Box));
+        throw;
+      }
+    }
+    return new (memory) Box{std::forward<U>(value), 1, charged};
+  }
+  void release() {
+    if (box && --box->refs == 0) {
+      memoryBudget().release(PayloadMemory<T>::category, box->charged);
+      box->~Box();
+      valuePool().deallocate(box, sizeof(Box));
+    }
+  }
+};
+
+#endif//PYTHON_INTERPRETER_COW_H
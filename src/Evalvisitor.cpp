@@ -1,5 +1,8 @@
 #include "Evalvisitor.h"
-#include <iomanip>
+#include "Stats.h"
+#include "FloatFormat.h"
+#include "Memory.h"
+#include "Output.h"
 #include <stdlib.h>
 #include <typeinfo>
 #include <iostream>
@@ -61,7 +64,11 @@ std::any EvalVisitor::to_double(std::any value) {
     for (auto i : *val) {
       tmp += i;
     }
-    ret = std::stod(tmp);
+    try {
+      ret = std::stod(tmp);
+    } catch (const std::logic_error &) {
+      throw std::runtime_error("ValueError: could not convert string to float: '" + tmp + "'");
+    }
   }
   if (auto val = std::any_cast<bool>(&value)) {
     ret = *val ? 1.0 : 0.0;
@@ -74,21 +81,26 @@ std::any EvalVisitor::to_string(std::any value) {
     return std::any(*val);
   }
   std::string ret;
-  if (auto val = std::any_cast<sjtu::int2048>(&value)) {
-    ret = val->to_string();
-  }
-  if (auto val = std::any_cast<double>(&value)) {
-    ret = std::to_string(*val);
-  }
-  if (auto val = std::any_cast<bool>(&value)) {
-    ret = *val ? "True" : "False";
-  }
-  if (auto val = std::any_cast<None>(&value)) {
-    ret = "None";
-  }
+  appendString(ret, value);
   return std::any(std::vector<std::string>{ret});
 }
 
+void EvalVisitor::appendString(std::string &out, const std::any &value) {
+  if (auto val = std::any_cast<std::vector<std::string>>(&value)) {
+    for (auto &s : *val) {
+      out += s;
+    }
+  } else if (auto val = std::any_cast<sjtu::int2048>(&value)) {
+    val->append_to(out);
+  } else if (auto val = std::any_cast<double>(&value)) {
+    appendDouble(out, *val);
+  } else if (auto val = std::any_cast<bool>(&value)) {
+    out += *val ? "True" : "False";
+  } else if (std::any_cast<None>(&value)) {
+    out += "None";
+  }
+}
+
 std::any EvalVisitor::print(const std::vector<std::any> &args_) {
   // std::cerr << "Print function called with " << args_.size() << " arguments." << std::endl;
   // unzip tuples
@@ -103,97 +115,89 @@ std::any EvalVisitor::print(const std::vector<std::any> &args_) {
       args.push_back(getVariable(i));
     }
   }
+  Output &out = output();
   for (size_t i = 0; i < args.size(); ++i) {
-    if (i > 0) std::cout << " ";
+    if (i > 0) out.put(' ');
     if (auto val = std::any_cast<std::vector<std::string>>(&args[i])) {
-      // std::cerr << "Printing string value." << std::endl;
-      std::string content;
-      for (auto &s : *val) {
-        content += s;
-      }
-      std::string processedStr;
-      for (size_t i = 0; i < content.length(); ++i) {
-        if (content[i] == '\\' && i + 1 < content.length()) {
-          char nextChar = content[i + 1];
-          if (nextChar == 'n') {
-            processedStr += '\n';
-            i++;
-          } else if (nextChar == 't') {
-            processedStr += '\t';
-            i++;
-          } else if (nextChar == 'r') {
-            processedStr += '\r';
-            i++;
-          } else if (nextChar == '\\') {
-            processedStr += '\\';
-            i++;
-          } else if (nextChar == '\"') {
-            processedStr += '\"';
-            i++;
-          } else {
-            processedStr += content[i];
-          }
-        } else {
-          processedStr += content[i];
+      std::string joined;
+      if (val->size() != 1) {
+        for (auto &s : *val) {
+          joined += s;
         }
       }
-      std::cout << processedStr;
+      const std::string &content = val->size() == 1 ? val->front() : joined;
+      out.writeEscaped(content.data(), content.length());
     } else if (auto val = std::any_cast<sjtu::int2048>(&args[i])) {
-      // std::cerr << "Printing int2048 value." << std::endl;
-      std::cout << *val;
+      out.writeInt(*val);
     } else if (auto val = std::any_cast<double>(&args[i])) {
-      // std::cerr << "Printing double value." << std::endl;
-      std::cout << std::fixed << std::setprecision(6) << *val;
+      out.writeDouble(*val);
     } else if (auto val = std::any_cast<bool>(&args[i])) {
-      std::cout << (*val ? "True" : "False");
-    } else if (auto val = std::any_cast<None>(&args[i])) {
-      std::cout << "None";
+      out.write(*val ? "True" : "False", *val ? 4 : 5);
+    } else if (std::any_cast<None>(&args[i])) {
+      out.write("None", 4);
     }
   }
-  std::cout << std::endl;
+  out.endLine();
   return std::any();
 }
 
-std::any EvalVisitor::callSystemFunction(const std::string &name, const std::vector<std::any> &args) {
-  if (name == "print") {
-    // std::cerr << "Calling system function 'print', args size: " << args.size() << std::endl;
-    return print(args);
-  }
-  if (name == "int") {
-    if (args.size() != 1) {
-      throw std::runtime_error("Too many arguments for int()");
-    }
-    return to_int(args[0]);
-  }
-  if (name == "float") {
-    if (args.size() != 1) {
-      throw std::runtime_error("Too many arguments for float()");
-    }
-    return to_double(args[0]);
-  }
-  if (name == "str") {
-    if (args.size() != 1) {
-      throw std::runtime_error("Too many arguments for str()");
-    }
-    return to_string(args[0]);
+const EvalVisitor::SystemFunction EvalVisitor::systemFunctions[(int)Builtin::BUILTIN_COUNT] = {
+    &EvalVisitor::print, &EvalVisitor::systemInt, &EvalVisitor::systemFloat,
+    &EvalVisitor::systemStr, &EvalVisitor::systemBool, &EvalVisitor::systemFactorial,
+};
+
+std::any EvalVisitor::callSystemFunction(Builtin builtin, const std::vector<std::any> &args) {
+  if (builtin != Builtin::PRINT && args.size() != 1) {
+    throw std::runtime_error(std::string("Too many arguments for ") + builtinName(builtin) + "()");
   }
-  if (name == "bool") {
-    if (args.size() != 1) {
-      throw std::runtime_error("Too many arguments for bool()");
-    }
-    return to_bool(args[0]);
+  return (this->*systemFunctions[(int)builtin])(args);
+}
+
+std::any EvalVisitor::systemInt(const std::vector<std::any> &args) {
+  return to_int(args[0]);
+}
+
+std::any EvalVisitor::systemFloat(const std::vector<std::any> &args) {
+  return to_double(args[0]);
+}
+
+std::any EvalVisitor::systemStr(const std::vector<std::any> &args) {
+  return to_string(args[0]);
+}
+
+std::any EvalVisitor::systemBool(const std::vector<std::any> &args) {
+  return to_bool(args[0]);
+}
+
+std::any EvalVisitor::systemFactorial(const std::vector<std::any> &args) {
+  if (!std::any_cast<sjtu::int2048>(&args[0]) && !std::any_cast<bool>(&args[0])) {
+    throw std::runtime_error("TypeError: factorial() argument must be an int");
   }
-  throw std::runtime_error("System function '" + name + "' not implemented");
+  return factorialOf(std::any_cast<sjtu::int2048>(to_int(args[0])));
+}
+
+size_t EvalVisitor::functionSlot(const std::string &name) {
+  auto it = functionSlots.find(name);
+  if (it != functionSlots.end()) return it->second;
+  functions.emplace_back();
+  functionSlots.emplace(name, functions.size() - 1);
+  return functions.size() - 1;
 }
 
 std::any EvalVisitor::getVariable(std::any const &val) {
   if (auto namePtr = std::any_cast<std::string>(&val)) {
-    std::string name = *namePtr;
-    if (variables.back().find(name) != variables.back().end()) {
-      return variables.back().at(name);
+    const std::string &name = *namePtr;
+    auto local = variables.back().find(name);
+    if (local != variables.back().end()) {
+      // at module level the innermost scope is the global one; count those
+      // reads as global, as the VM does
+      if (stats().enabled) (variables.size() == 1 ? stats().globalReads : stats().localReads)++;
+      return local->second;
     }
-    if (variables.front().find(name) != variables.front().end()) {
-      return variables.front().at(name);
+    auto global = variables.front().find(name);
+    if (global != variables.front().end()) {
+      if (stats().enabled) stats().globalReads++;
+      return global->second;
     }
     // for (auto it = variables.rbegin(); it != variables.rend(); ++it) {
     //   auto found = it->find(name);
@@ -224,15 +228,38 @@ void EvalVisitor::setVariable(const std::string &name, const std::any &value) {
   variables.back()[name] = value;
 }
 
-std::any EvalVisitor::operate(const std::string &op, std::any left, std::any right) {
+// The Value type a tree-engine value corresponds to, for statistics.
+static Value::Type typeOf(const std::any &value) {
+  const std::type_info &type = value.type();
+  if (type == typeid(sjtu::int2048)) return Value::INT;
+  if (type == typeid(double)) return Value::FLOAT;
+  if (type == typeid(bool)) return Value::BOOL;
+  if (type == typeid(std::vector<std::string>)) return Value::STR;
+  if (type == typeid(std::string)) return Value::UNDEFINED;
+  if (type == typeid(None)) return Value::NONE;
+  if (type == typeid(std::vector<std::any>)) return Value::TUPLE;
+  return Value::UNBOUND;
+}
+
+// Bytes a piecewise string holds, so that concatenation and repetition can
+// raise MemoryError before building a result that would not fit.
+static double stringBytes(const std::vector<std::string> &pieces) {
+  double bytes = 0;
+  for (auto &piece : pieces) bytes += sizeof(std::string) + piece.size();
+  return bytes;
+}
+
+std::any EvalVisitor::operate(BinaryOp op, std::any left, std::any right) {
+  if (stats().enabled) stats().countBinary(op, typeOf(left), typeOf(right));
   // std::cerr << "Operating: " << op << std::endl;
   // std::cerr << "Left type: " << left.type().name() << ", Right type: " << right.type().name() << std::endl;
-  if (op == "+") {
+  if (op == BinaryOp::ADD) {
     if (left.type() == typeid(std::vector<std::string>) && right.type() == typeid(std::vector<std::string>)) {
       // std::cerr << "String concatenation operation" << std::endl;
       std::vector<std::string> result;
       auto leftVec = std::any_cast<std::vector<std::string>>(left);
       auto rightVec = std::any_cast<std::vector<std::string>>(right);
+      memoryBudget().check(stringBytes(leftVec) + stringBytes(rightVec));
       result.insert(result.end(), leftVec.begin(), leftVec.end());
       result.insert(result.end(), rightVec.begin(), rightVec.end());
       return std::any(result);
@@ -250,7 +277,7 @@ std::any EvalVisitor::operate(const std::string &op, std::any left, std::any rig
     return std::any(std::any_cast<sjtu::int2048>(leftVal) + std::any_cast<sjtu::int2048>(rightVal));
   }
 
-  if (op == "-") {
+  if (op == BinaryOp::SUB) {
     if (left.type() == typeid(std::vector<std::string>) || right.type() == typeid(std::vector<std::string>)) {
       throw std::runtime_error("TypeError: unsupported operand type(s) for -: 'str'");
     }
@@ -264,7 +291,7 @@ std::any EvalVisitor::operate(const std::string &op, std::any left, std::any rig
     return std::any(std::any_cast<sjtu::int2048>(leftVal) - std::any_cast<sjtu::int2048>(rightVal));
   }
 
-  if (op == "*") {
+  if (op == BinaryOp::MUL) {
     if (right.type() == typeid(std::vector<std::string>) && left.type() == typeid(sjtu::int2048)) {
       std::swap(left, right);
     }
@@ -274,6 +301,7 @@ std::any EvalVisitor::operate(const std::string &op, std::any left, std::any rig
       if (times <= sjtu::int2048(0)) {
         return std::any(std::vector<std::string>{""});
       }
+      memoryBudget().check(stringBytes(strVec) * times.to_double());
       std::vector<std::string> result;
       for (sjtu::int2048 i = sjtu::int2048(0); i < times; i += sjtu::int2048(1)) {
         result.insert(result.end(), strVec.begin(), strVec.end());
@@ -305,7 +333,7 @@ std::any EvalVisitor::operate(const std::string &op, std::any left, std::any rig
     return std::any(std::any_cast<sjtu::int2048>(leftVal) * std::any_cast<sjtu::int2048>(rightVal));
   }
 
-  if (op == "/") {
+  if (op == BinaryOp::DIV) {
     if (left.type() == typeid(std::vector<std::string>) || right.type() == typeid(std::vector<std::string>)) {
       throw std::runtime_error("TypeError: unsupported operand type(s) for /: 'str'");
     }
@@ -317,7 +345,7 @@ std::any EvalVisitor::operate(const std::string &op, std::any left, std::any rig
     return std::any(std::any_cast<double>(leftVal) / std::any_cast<double>(rightVal));
   }
 
-  if (op == "//") {
+  if (op == BinaryOp::IDIV) {
     if (left.type() == typeid(std::vector<std::string>) || right.type() == typeid(std::vector<std::string>)) {
       throw std::runtime_error("TypeError: unsupported operand type(s) for //: 'str'");
     }
@@ -337,7 +365,7 @@ std::any EvalVisitor::operate(const std::string &op, std::any left, std::any rig
     return std::any(std::any_cast<sjtu::int2048>(leftVal) / std::any_cast<sjtu::int2048>(rightVal));
   }
 
-  if (op == "%") {
+  if (op == BinaryOp::MOD) {
     if (left.type() == typeid(std::vector<std::string>) || right.type() == typeid(std::vector<std::string>)) {
       throw std::runtime_error("TypeError: unsupported operand type(s) for %: 'str'");
     }
@@ -357,7 +385,7 @@ std::any EvalVisitor::operate(const std::string &op, std::any left, std::any rig
     return std::any(std::fmod(std::any_cast<double>(leftVal), std::any_cast<double>(rightVal)));
   }
 
-  if (op == ">") {
+  if (op == BinaryOp::GT) {
     if (left.type() == typeid(std::vector<std::string>) && right.type() == typeid(std::vector<std::string>)) {
       std::string leftStr, rightStr;
       for (auto i : std::any_cast<std::vector<std::string>>(left)) {
@@ -381,7 +409,7 @@ std::any EvalVisitor::operate(const std::string &op, std::any left, std::any rig
     return std::any(std::any_cast<sjtu::int2048>(leftVal) > std::any_cast<sjtu::int2048>(rightVal));
   }
 
-  if (op == "<") {
+  if (op == BinaryOp::LT) {
     if (left.type() == typeid(std::vector<std::string>) && right.type() == typeid(std::vector<std::string>)) {
       std::string leftStr, rightStr;
       for (auto i : std::any_cast<std::vector<std::string>>(left)) {
@@ -405,17 +433,17 @@ std::any EvalVisitor::operate(const std::string &op, std::any left, std::any rig
     return std::any(std::any_cast<sjtu::int2048>(leftVal) < std::any_cast<sjtu::int2048>(rightVal));
   }
 
-  if (op == ">=") {
-    auto result = std::any_cast<bool>(operate(std::string("<"), left, right));
+  if (op == BinaryOp::GE) {
+    auto result = std::any_cast<bool>(operate(BinaryOp::LT, left, right));
     return std::any(!result);
   }
 
-  if (op == "<=") {
-    auto result = std::any_cast<bool>(operate(std::string(">"), left, right));
+  if (op == BinaryOp::LE) {
+    auto result = std::any_cast<bool>(operate(BinaryOp::GT, left, right));
     return std::any(!result);
   }
 
-  if (op == "==") {
+  if (op == BinaryOp::EQ) {
     if (left.type() == typeid(std::vector<std::string>) && right.type() == typeid(std::vector<std::string>)) {
       std::string leftStr, rightStr;
       for (auto i : std::any_cast<std::vector<std::string>>(left)) {
@@ -446,25 +474,35 @@ std::any EvalVisitor::operate(const std::string &op, std::any left, std::any rig
     return std::any(std::any_cast<sjtu::int2048>(leftVal) == std::any_cast<sjtu::int2048>(rightVal));
   }
 
-  if (op == "!=") {
-    auto result = std::any_cast<bool>(operate("==", left, right));
+  if (op == BinaryOp::NE) {
+    auto result = std::any_cast<bool>(operate(BinaryOp::EQ, left, right));
     return std::any(!result);
   }
   
-  return std::runtime_error("Invalid operator: " + op);
+  throw std::runtime_error(std::string("Invalid operator: ") + binaryOpName(op));
 }
 
 EvalVisitor::EvalVisitor() {
-  variables.emplace_back(std::map<std::string, std::any>{});
+  variables.emplace_back();
 }
 
 std::any EvalVisitor::visitFile_input(Python3Parser::File_inputContext *ctx) {
   auto statements = ctx->stmt();
+  if (profiler) profiler->enter(profiler->function("<module>"));
   try {
     for (auto stmt : statements) {
       visit(stmt);
     }
   } catch (const std::runtime_error &e) {
+    output().flush();
+    std::cerr << "Runtime Error: " << e.what() << std::endl;
+    exit(1);
+  } catch (const std::bad_alloc &) {
+    output().flush();
+    std::cerr << "Runtime Error: MemoryError" << std::endl;
+    exit(1);
+  } catch (const std::exception &e) {
+    output().flush();
     std::cerr << "Runtime Error: " << e.what() << std::endl;
     exit(1);
   }
@@ -475,10 +513,10 @@ std::any EvalVisitor::visitFuncdef(Python3Parser::FuncdefContext *ctx) {
   std::string funcName = ctx->NAME()->getText();
   auto paramsCtx = visit(ctx->parameters());
   auto typedArgsListCtx = std::any_cast<std::vector<FunctionArgument>>(paramsCtx);
-  Function func;
-  func.parameters = typedArgsListCtx;
-  func.body = ctx->suite();
-  functions[funcName] = func;
+  auto func = std::make_shared<Function>();
+  func->parameters = typedArgsListCtx;
+  func->body = ctx->suite();
+  functions[functionSlot(funcName)] = std::move(func);
   return std::any();
 }
 
@@ -521,6 +559,7 @@ std::any EvalVisitor::visitTfpdef(Python3Parser::TfpdefContext *ctx) {
 }
 
 std::any EvalVisitor::visitStmt(Python3Parser::StmtContext *ctx) {
+  if (profiler) profiler->line(ctx->getStart()->getLine());
   if (ctx->simple_stmt()) {
     return visit(ctx->simple_stmt());
   } else if (ctx->compound_stmt()) {
@@ -530,6 +569,8 @@ std::any EvalVisitor::visitStmt(Python3Parser::StmtContext *ctx) {
 }
 
 std::any EvalVisitor::visitSimple_stmt(Python3Parser::Simple_stmtContext *ctx) {
+  // a suite on the same line as its header has no StmtContext
+  if (profiler) profiler->line(ctx->getStart()->getLine());
   auto small_stmt = ctx->small_stmt();
   return visit(small_stmt);
 }
@@ -553,8 +594,7 @@ std::any EvalVisitor::visitExpr_stmt(Python3Parser::Expr_stmtContext *ctx) {
   // auto testlistCtx = std::any_cast<std::vector<std::any>>(value);
   if (ctx->augassign()) {
     auto var = std::any_cast<std::vector<std::any>>(visit(testlist_ctx[0]));
-    auto op = std::any_cast<std::string>(visit(ctx->augassign()));
-    op = op.substr(0, op.size() - 1); // remove '='
+    auto op = std::any_cast<BinaryOp>(visit(ctx->augassign()));
     for (int i = 0; i < var.size(); ++i) {
       if (auto varNamePtr = std::any_cast<std::string>(&var[i])) {
         std::string varName = *varNamePtr;
@@ -586,22 +626,22 @@ std::any EvalVisitor::visitExpr_stmt(Python3Parser::Expr_stmtContext *ctx) {
 
 std::any EvalVisitor::visitAugassign(Python3Parser::AugassignContext *ctx) {
   if (ctx->ADD_ASSIGN()) {
-    return std::string("+=");
+    return BinaryOp::ADD;
   }
   if (ctx->SUB_ASSIGN()) {
-    return std::string("-=");
+    return BinaryOp::SUB;
   }
   if (ctx->MULT_ASSIGN()) {
-    return std::string("*=");
+    return BinaryOp::MUL;
   }
   if (ctx->DIV_ASSIGN()) {
-    return std::string("/=");
+    return BinaryOp::DIV;
   }
   if (ctx->IDIV_ASSIGN()) {
-    return std::string("//=");
+    return BinaryOp::IDIV;
   }
   if (ctx->MOD_ASSIGN()) {
-    return std::string("%=");
+    return BinaryOp::MOD;
   }
   throw std::runtime_error("Invalid augmented assignment operator");
 }
@@ -686,6 +726,8 @@ std::any EvalVisitor::visitIf_stmt(Python3Parser::If_stmtContext *ctx) {
 
 std::any EvalVisitor::visitWhile_stmt(Python3Parser::While_stmtContext *ctx) {
   while (true) {
+    // the condition runs on every iteration, not just when the statement is entered
+    if (profiler) profiler->line(ctx->getStart()->getLine());
     auto conditionCtx = ctx->test();
     auto conditionValue = getVariable(visit(conditionCtx));
     if (!std::any_cast<bool>(to_bool(conditionValue))) {
@@ -793,7 +835,7 @@ std::any EvalVisitor::visitComparison(Python3Parser::ComparisonContext *ctx) {
   for (size_t i = 0; i < compOps.size(); ++i) {
     auto rightValue = visit(arithExprs[i + 1]);
     rightValue = getVariable(rightValue);
-    auto op = std::any_cast<std::string>(visit(compOps[i]));
+    auto op = std::any_cast<BinaryOp>(visit(compOps[i]));
     auto comparisonResult = operate(op, leftValue, rightValue);
     if (!std::any_cast<bool>(comparisonResult)) {
       return std::any(false);
@@ -805,22 +847,22 @@ std::any EvalVisitor::visitComparison(Python3Parser::ComparisonContext *ctx) {
 
 std::any EvalVisitor::visitComp_op(Python3Parser::Comp_opContext *ctx) {
   if (ctx->LESS_THAN()) {
-    return std::string("<");
+    return BinaryOp::LT;
   }
   if (ctx->GREATER_THAN()) {
-    return std::string(">");
+    return BinaryOp::GT;
   }
   if (ctx->EQUALS()) {
-    return std::string("==");
+    return BinaryOp::EQ;
   }
   if (ctx->GT_EQ()) {
-    return std::string(">=");
+    return BinaryOp::GE;
   }
   if (ctx->LT_EQ()) {
-    return std::string("<=");
+    return BinaryOp::LE;
   }
   if (ctx->NOT_EQ_2()) {
-    return std::string("!=");
+    return BinaryOp::NE;
   }
   throw std::runtime_error("Invalid comparison operator");
 }
@@ -839,7 +881,7 @@ std::any EvalVisitor::visitArith_expr(Python3Parser::Arith_exprContext *ctx) {
   for (size_t i = 0; i < addorsubOps.size(); ++i) {
     auto nextValue = visit(terms[i + 1]);
     nextValue = getVariable(nextValue);
-    auto op = std::any_cast<std::string>(visit(addorsubOps[i]));
+    auto op = std::any_cast<BinaryOp>(visit(addorsubOps[i]));
     // std::cerr << "Visiting arith_expr operator" << std::endl;
     result = operate(op, result, nextValue);
   }
@@ -848,10 +890,10 @@ std::any EvalVisitor::visitArith_expr(Python3Parser::Arith_exprContext *ctx) {
 
 std::any EvalVisitor::visitAddorsub_op(Python3Parser::Addorsub_opContext *ctx) {
   if (ctx->ADD()) {
-    return std::string("+");
+    return BinaryOp::ADD;
   }
   if (ctx->MINUS()) {
-    return std::string("-");
+    return BinaryOp::SUB;
   }
   throw std::runtime_error("Invalid add or sub operator");
 }
@@ -871,7 +913,7 @@ std::any EvalVisitor::visitTerm(Python3Parser::TermContext *ctx) {
   for (size_t i = 0; i < muldivmodOps.size(); ++i) {
     auto nextValue = visit(factors[i + 1]);
     nextValue = getVariable(nextValue);
-    auto op = std::any_cast<std::string>(visit(muldivmodOps[i]));
+    auto op = std::any_cast<BinaryOp>(visit(muldivmodOps[i]));
     result = operate(op, result, nextValue);
   }
   return result;
@@ -879,16 +921,16 @@ std::any EvalVisitor::visitTerm(Python3Parser::TermContext *ctx) {
 
 std::any EvalVisitor::visitMuldivmod_op(Python3Parser::Muldivmod_opContext *ctx) {
   if (ctx->STAR()) {
-    return std::string("*");
+    return BinaryOp::MUL;
   }
   if (ctx->DIV()) {
-    return std::string("/");
+    return BinaryOp::DIV;
   }
   if (ctx->IDIV()) {
-    return std::string("//");
+    return BinaryOp::IDIV;
   }
   if (ctx->MOD()) {
-    return std::string("%");
+    return BinaryOp::MOD;
   }
   throw std::runtime_error("Invalid mul/div/mod operator");
 }
@@ -938,6 +980,12 @@ std::any EvalVisitor::visitFactor(Python3Parser::FactorContext *ctx) {
   throw std::runtime_error("Invalid factor");
 }
 
+// The expression whose value an argument passes: test for a positional
+// argument, the test after '=' for a keyword one.
+static Python3Parser::TestContext *argumentValue(Python3Parser::ArgumentContext *arg) {
+  return arg->test(arg->ASSIGN() ? 1 : 0);
+}
+
 std::any EvalVisitor::visitAtom_expr(Python3Parser::Atom_exprContext *ctx) {
   // std::cerr << "Visiting atom_expr" << std::endl;
   auto atomCtx = visit(ctx->atom());
@@ -947,44 +995,76 @@ std::any EvalVisitor::visitAtom_expr(Python3Parser::Atom_exprContext *ctx) {
   // std::cerr << "Atom type: " << atomCtx.type().name() << std::endl;
   if (atomCtx.type() == typeid(std::string) && ctx->trailer()) {
     // function call
-    std::string funcName = std::any_cast<std::string>(atomCtx);
-    if (systemFunctions.count(funcName)) {
+    const std::string &funcName = std::any_cast<const std::string &>(atomCtx);
+    // bind the call site on its first call
+    auto target = callTargets.find(ctx);
+    if (target == callTargets.end()) {
+      Builtin builtin = findBuiltin(funcName);
+      size_t slot = builtin == Builtin::BUILTIN_COUNT ? functionSlot(funcName) : 0;
+      target = callTargets.emplace(ctx, CallTarget{builtin, slot}).first;
+    }
+    auto arglist = ctx->trailer()->arglist();
+    std::vector<Python3Parser::ArgumentContext*> args;
+    if (arglist) args = arglist->argument();
+    if (target->second.builtin != Builtin::BUILTIN_COUNT) {
       // handle system functions
-      auto trailerCtx = visit(ctx->trailer());
       std::vector<std::any> argValues;
-      for (auto &argCtx : std::any_cast<std::vector<Argument>>(trailerCtx)) {
-        argValues.push_back(argCtx.value);
+      argValues.reserve(args.size());
+      for (auto arg : args) {
+        argValues.push_back(getVariable(visit(argumentValue(arg))));
       }
-      return callSystemFunction(funcName, argValues);
+      return callSystemFunction(target->second.builtin, argValues);
     }
     // std::cerr << "Calling function '" << funcName << "'" << std::endl;
-    auto funcIt = functions.find(funcName);
-    if (funcIt == functions.end()) {
-      throw std::runtime_error("Function '" + funcName + "' not defined");
-    }
-    Function func = funcIt->second;
-    // evaluate arguments
-    auto trailerCtx = visit(ctx->trailer());
-    std::map<std::string, std::any> argMap;
-    for (auto &argCtx : std::any_cast<std::vector<Argument>>(trailerCtx)) {
-      if (argCtx.name.empty()) {
-        argMap[func.parameters[argCtx.id].name] = argCtx.value;
-      } else {
-        argMap[argCtx.name] = argCtx.value;
+    // hold a reference, in case the body redefines the function
+    std::shared_ptr<const Function> funcPtr = functions[target->second.slot];
+    if (!funcPtr) {
+      // no user function of this name; it may be a library builtin
+      Builtin library = findBuiltin(funcName, true);
+      if (library == Builtin::BUILTIN_COUNT) {
+        throw std::runtime_error("Function '" + funcName + "' not defined");
+      }
+      std::vector<std::any> argValues;
+      argValues.reserve(args.size());
+      for (auto arg : args) {
+        if (arg->ASSIGN()) throw std::runtime_error("TypeError: " + funcName + "() takes no keyword arguments");
+        argValues.push_back(getVariable(visit(argumentValue(arg))));
       }
+      return callSystemFunction(library, argValues);
     }
-    for (auto &param : func.parameters) {
-      if (argMap.find(param.name) == argMap.end()) {
-        if (param.default_value.has_value()) {
-          argMap[param.name] = param.default_value;
-        } else {
-          throw std::runtime_error("Function '" + funcName + "' missing required argument: " + param.name);
-        }
+    const Function &func = *funcPtr;
+    if (target->second.resolvedFor != funcPtr) {
+      resolveArguments(target->second, funcPtr, funcName, args);
+    }
+    // evaluate arguments straight into the parameter they bind
+    CallTarget &call = target->second;
+    std::vector<std::any> params(func.parameters.size());
+    for (size_t i = 0; i < args.size(); ++i) {
+      std::any value = getVariable(visit(argumentValue(args[i])));
+      // an argument may have called this site again after a redefinition
+      if (call.resolvedFor != funcPtr) resolveArguments(call, funcPtr, funcName, args);
+      params[call.paramIndex[i]] = std::move(value);
+    }
+    Scope scope;
+    for (size_t i = 0; i < params.size(); ++i) {
+      auto &param = func.parameters[i];
+      if (params[i].has_value()) {
+        scope.emplace(param.name, std::move(params[i]));
+      } else if (param.default_value.has_value()) {
+        scope.emplace(param.name, param.default_value);
+      } else {
+        throw std::runtime_error("Function '" + funcName + "' missing required argument: " + param.name);
       }
     }
-    variables.push_back(argMap);
+    variables.push_back(std::move(scope));
+    if (stats().enabled) stats().countCall(variables.size() - 1);
+    if (profiler) {
+      if (call.profileId < 0) call.profileId = profiler->function(funcName);
+      profiler->enter(call.profileId);
+    }
     // execute function body
     auto result = visit(func.body);
+    if (profiler) profiler->leave();
     auto ret = std::any(None{});
     if (result.type() == typeid(Flow)) {
       auto flowControl = std::any_cast<Flow>(result);
@@ -1009,6 +1089,29 @@ std::any EvalVisitor::visitAtom_expr(Python3Parser::Atom_exprContext *ctx) {
   return atomCtx;
 }
 
+void EvalVisitor::resolveArguments(CallTarget &target, const std::shared_ptr<const Function> &func,
+                                   const std::string &name,
+                                   const std::vector<Python3Parser::ArgumentContext*> &args) {
+  auto &parameters = func->parameters;
+  target.paramIndex.resize(args.size());
+  for (size_t i = 0; i < args.size(); ++i) {
+    size_t index = i;
+    if (args[i]->ASSIGN()) {
+      std::string keyword = args[i]->test(0)->getText();
+      index = 0;
+      while (index < parameters.size() && parameters[index].name != keyword) ++index;
+      if (index == parameters.size()) {
+        throw std::runtime_error("TypeError: " + name + "() got an unexpected keyword argument '" + keyword + "'");
+      }
+    } else if (index >= parameters.size()) {
+      throw std::runtime_error("TypeError: " + name + "() takes " + std::to_string(parameters.size()) +
+                               " positional arguments but " + std::to_string(args.size()) + " were given");
+    }
+    target.paramIndex[i] = index;
+  }
+  target.resolvedFor = func;
+}
+
 std::any EvalVisitor::visitTrailer(Python3Parser::TrailerContext *ctx) {
   if (ctx->arglist()) {
     auto argsCtx = visit(ctx->arglist());
@@ -1021,16 +1124,22 @@ std::any EvalVisitor::visitAtom(Python3Parser::AtomContext *ctx) {
   if (ctx->NAME()) {
     return ctx->NAME()->getText();
   }
+  if (ctx->NUMBER() || ctx->STRING(0)) {
+    auto cached = literals.find(ctx);
+    if (cached != literals.end()) {
+      return cached->second;
+    }
+  }
   if (ctx->NUMBER()) {
     std::string numText = ctx->NUMBER()->getText();
     if (numText.find('.') != std::string::npos || numText.find('e') != std::string::npos || numText.find('E') != std::string::npos) {
       // float
       double value = std::stod(numText);
-      return std::any(value);
+      return literals[ctx] = std::any(value);
     } else {
       // int
       sjtu::int2048 value(numText);
-      return std::any(value);
+      return literals[ctx] = std::any(value);
     }
   }
   if (ctx->STRING(0)) {
@@ -1071,7 +1180,7 @@ std::any EvalVisitor::visitAtom(Python3Parser::AtomContext *ctx) {
       // std::cerr << "Processed string: " << processedStr << std::endl;
       ret.push_back(processedStr);
     }
-    return ret;
+    return literals[ctx] = std::any(std::move(ret));
   }
   if (ctx->TRUE()) {
     return true;
@@ -1091,40 +1200,59 @@ std::any EvalVisitor::visitAtom(Python3Parser::AtomContext *ctx) {
   throw std::runtime_error("Invalid atom");
 }
 
-std::any EvalVisitor::visitFormat_string(Python3Parser::Format_stringContext *ctx) {
-  auto strings = ctx->FORMAT_STRING_LITERAL();
-  auto tests = ctx->testlist();
-  auto braces = ctx->OPEN_BRACE();
-  std::vector<std::string> result;
-  int i = 0, j = 0;
-  while (i < strings.size() || j < tests.size()) {
-    if (i < strings.size() && (j >= tests.size() || strings[i]->getSymbol()->getTokenIndex() < braces[j]->getSymbol()->getTokenIndex())) {
-      auto str = strings[i]->getText();
-      auto pos = str.find("{{");
-      while (pos != std::string::npos) {
-        str.replace(pos, 2, "{");
-        pos = str.find("{{", pos + 1);
-      }
-      pos = str.find("}}");
-      while (pos != std::string::npos) {
-        str.replace(pos, 2, "}");
-        pos = str.find("}}", pos + 1);
+const FormatTemplate &EvalVisitor::compileFormatString(Python3Parser::Format_stringContext *ctx) {
+  auto it = formatTemplates.find(ctx);
+  if (it != formatTemplates.end()) {
+    return it->second;
+  }
+  // children are already in source order: f" (literal | { testlist })* "
+  FormatTemplate tmpl;
+  for (auto child : ctx->children) {
+    if (auto test = dynamic_cast<Python3Parser::TestlistContext *>(child)) {
+      FormatSegment segment;
+      segment.expr = test;
+      tmpl.segments.push_back(segment);
+      continue;
+    }
+    auto terminal = dynamic_cast<antlr4::tree::TerminalNode *>(child);
+    if (!terminal || terminal->getSymbol()->getType() != Python3Parser::FORMAT_STRING_LITERAL) {
+      continue;
+    }
+    if (tmpl.segments.empty() || tmpl.segments.back().expr) {
+      tmpl.segments.emplace_back();
+    }
+    std::string &literal = tmpl.segments.back().literal;
+    std::string text = terminal->getText();
+    for (size_t i = 0; i < text.length(); ++i) {
+      literal += text[i];
+      if ((text[i] == '{' || text[i] == '}') && i + 1 < text.length() && text[i + 1] == text[i]) {
+        i++;
       }
-      result.push_back(str);
-      i++;
-    } else if (j < tests.size()) {
-      auto value = visit(tests[j]);
-      if (auto val = std::any_cast<std::vector<std::any>>(&value)) {
-        for (auto element : *val) {
-          auto strVal = to_string(getVariable(element));
-          auto strs = std::any_cast<std::vector<std::string>>(strVal);
-          result.insert(result.end(), strs.begin(), strs.end());
-        }
+    }
+  }
+  for (auto &segment : tmpl.segments) {
+    tmpl.literal_length += segment.literal.size();
+  }
+  return formatTemplates.emplace(ctx, std::move(tmpl)).first->second;
+}
+
+std::any EvalVisitor::visitFormat_string(Python3Parser::Format_stringContext *ctx) {
+  const FormatTemplate &tmpl = compileFormatString(ctx);
+  std::string result;
+  result.reserve(tmpl.literal_length + 16 * tmpl.segments.size());
+  for (auto &segment : tmpl.segments) {
+    if (!segment.expr) {
+      result += segment.literal;
+      continue;
+    }
+    auto value = visit(segment.expr);
+    if (auto val = std::any_cast<std::vector<std::any>>(&value)) {
+      for (auto &element : *val) {
+        appendString(result, getVariable(element));
       }
-      j++;
     }
   }
-  return result;
+  return std::vector<std::string>{std::move(result)};
 }
 
 std::any EvalVisitor::visitTestlist(Python3Parser::TestlistContext *ctx) {
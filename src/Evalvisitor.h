@@ -3,11 +3,16 @@
 #define PYTHON_INTERPRETER_EVALVISITOR_H
 
 #include <any>
-#include <set>
 #include <map>
+#include <memory>
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include "Bytecode.h"
 #include "int2048.h"
+#include "Pool.h"
+#include "Profiler.h"
+#include "Value.h"
 #include "Python3ParserBaseVisitor.h"
 
 // Structure to hold argument information for function definitions
@@ -29,8 +34,24 @@ struct Function {
   Python3Parser::SuiteContext* body;
 };
 
-// This structure does what you think it does.
-struct None {};
+// One piece of a compiled f-string: either a literal run (with {{ and }}
+// already unescaped) or an expression slot to evaluate at runtime.
+struct FormatSegment {
+  std::string literal;
+  Python3Parser::TestlistContext* expr = nullptr;
+};
+
+// An f-string compiled once into its segments.
+// literal_length is the total size of the literal runs, used to reserve the output.
+struct FormatTemplate {
+  std::vector<FormatSegment> segments;
+  size_t literal_length = 0;
+};
+
+// Variables of one scope. Its nodes come from valuePool(), so the scope of
+// each call reuses the nodes of earlier ones.
+using Scope = std::map<std::string, std::any, std::less<std::string>,
+                       PoolAllocator<std::pair<const std::string, std::any>>>;
 
 struct Flow {
   enum Type { BREAK, CONTINUE, RETURN } type;
@@ -40,14 +61,38 @@ struct Flow {
 class EvalVisitor : public Python3ParserBaseVisitor {
 private:
   // Stack of variable scopes
-  std::vector<std::map<std::string, std::any>> variables;
-
-  // Map of function names to their definitions
-  std::map<std::string, Function> functions;
-
-  // System functions
-  std::set<std::string> systemFunctions = {"print", "int", "float", "str", "bool"};
-  std::any callSystemFunction(const std::string &name, const std::vector<std::any> &args);
+  std::vector<Scope> variables;
+
+  // Function definitions. A name gets a slot the first time it is defined
+  // or called; a def replaces the slot's contents, so call sites can keep
+  // the slot index instead of looking the name up on every call.
+  std::vector<std::shared_ptr<const Function>> functions;
+  std::unordered_map<std::string, size_t> functionSlots;
+  size_t functionSlot(const std::string &name);
+
+  // What a call site calls: a system function, or else the function in slot.
+  // paramIndex[i] is the parameter that argument i binds, worked out for
+  // resolvedFor and redone only when the slot holds a different function.
+  struct CallTarget {
+    Builtin builtin;
+    size_t slot;
+    std::shared_ptr<const Function> resolvedFor = nullptr;
+    std::vector<size_t> paramIndex = {};
+    int profileId = -1;
+  };
+  std::unordered_map<Python3Parser::Atom_exprContext*, CallTarget> callTargets;
+  void resolveArguments(CallTarget &target, const std::shared_ptr<const Function> &func,
+                        const std::string &name, const std::vector<Python3Parser::ArgumentContext*> &args);
+
+  // System functions, indexed by Builtin
+  using SystemFunction = std::any (EvalVisitor::*)(const std::vector<std::any> &args);
+  static const SystemFunction systemFunctions[(int)Builtin::BUILTIN_COUNT];
+  std::any callSystemFunction(Builtin builtin, const std::vector<std::any> &args);
+  std::any systemInt(const std::vector<std::any> &args);
+  std::any systemFloat(const std::vector<std::any> &args);
+  std::any systemStr(const std::vector<std::any> &args);
+  std::any systemBool(const std::vector<std::any> &args);
+  std::any systemFactorial(const std::vector<std::any> &args);
 
   // Find the value of a variable
   std::any getVariable(std::any const &val);
@@ -57,7 +102,7 @@ private:
 
   // Perform operations include + - * / // % > < >= <= == !=
   // Throws runtime_error for unsupported operand types
-  std::any operate(const std::string &op, std::any left, std::any right);
+  std::any operate(BinaryOp op, std::any left, std::any right);
 
   // Type conversion helpers
   std::any to_int(std::any value);
@@ -65,6 +110,20 @@ private:
   std::any to_double(std::any value);
   std::any to_string(std::any value);
 
+  // Append the str() form of a value to out without building temporaries.
+  void appendString(std::string &out, const std::any &value);
+
+  // Compiled f-string templates, keyed by their parse tree node
+  std::unordered_map<Python3Parser::Format_stringContext*, FormatTemplate> formatTemplates;
+  const FormatTemplate &compileFormatString(Python3Parser::Format_stringContext *ctx);
+
+  // NUMBER and STRING atoms already converted to values, keyed by their
+  // parse tree node, so loops do not re-parse the token text
+  std::unordered_map<Python3Parser::AtomContext*, std::any> literals;
+
+  // Receives lines and calls when profiling, otherwise null
+  Profiler *profiler = nullptr;
+
   // Print function
   std::any print(const std::vector<std::any> &args);
 
@@ -73,6 +132,9 @@ public:
   // Initializes the variable scope stack with a global scope.
   EvalVisitor();
 
+  // Report every statement and user function call to profiler.
+  void setProfiler(Profiler *profiler) { this->profiler = profiler; }
+
   // Visit the parse tree nodes produced by Python3Parser and evaluate the Python code.
   // If a node throws a runtime_error, it indicates an error during evaluation.
   std::any visitFile_input(Python3Parser::File_inputContext *ctx) override;
@@ -106,7 +168,7 @@ public:
   std::any visitExpr_stmt(Python3Parser::Expr_stmtContext *ctx) override;
 
   // Visit augmented assignment statements.
-  // Returns the operation as a string: +=, -=, *=, /=, //=, %=.
+  // Returns the operation as a BinaryOp: ADD for +=, SUB for -=, and so on.
   std::any visitAugassign(Python3Parser::AugassignContext *ctx) override;
 
   // Visit flow statements.
@@ -152,21 +214,21 @@ public:
   std::any visitComparison(Python3Parser::ComparisonContext *ctx) override;
 
   // Visit comparison operators.
-  // Returns the operator as a string: <, >, ==, >=, <=, !=.
+  // Returns the operator as a BinaryOp: LT, GT, EQ, GE, LE or NE.
   std::any visitComp_op(Python3Parser::Comp_opContext *ctx) override;
 
   // Visit arithmetic expressions.
   std::any visitArith_expr(Python3Parser::Arith_exprContext *ctx) override;
 
   // Visit addition and subtraction operators.
-  // Returns the operator as a string: + or -.
+  // Returns the operator as a BinaryOp: ADD or SUB.
   std::any visitAddorsub_op(Python3Parser::Addorsub_opContext *ctx) override;
 
   // Visit term expressions.
   std::any visitTerm(Python3Parser::TermContext *ctx) override;
 
   // Visit multiplication, division, floor division, and modulus operators.
-  // Returns the operator as a string: *, /, //, or %.
+  // Returns the operator as a BinaryOp: MUL, DIV, IDIV or MOD.
   std::any visitMuldivmod_op(Python3Parser::Muldivmod_opContext *ctx) override;
 
   // Visit factor expressions.
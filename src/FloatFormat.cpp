@@ -0,0 +1,101 @@
+#include "FloatFormat.h"
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+
+static FloatStyle floatStyle = FloatStyle::FIXED;
+
+void setFloatStyle(FloatStyle style) {
+  floatStyle = style;
+}
+
+FloatStyle getFloatStyle() {
+  return floatStyle;
+}
+
+// CPython's float_repr: take the shortest round-trip digits and lay them out
+// in positional notation when -4 < decpt <= 16, scientific otherwise.
+static size_t formatRepr(char *buf, double value) {
+  // -Ofast assumes finite math and drops std::isnan and std::isinf, so
+  // look for an all-ones exponent in the bits instead
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  if ((bits >> 52 & 0x7ff) == 0x7ff) {
+    if (bits & ((1ull << 52) - 1)) {
+      memcpy(buf, "nan", 3);
+      return 3;
+    }
+    if (bits >> 63) {
+      memcpy(buf, "-inf", 4);
+      return 4;
+    }
+    memcpy(buf, "inf", 3);
+    return 3;
+  }
+  // shortest scientific form, e.g. "-1.2345e+02"
+  char sci[32];
+  char *end = std::to_chars(sci, sci + sizeof(sci), value, std::chars_format::scientific).ptr;
+  char *p = sci;
+  char *out = buf;
+  if (*p == '-') {
+    *out++ = '-';
+    p++;
+  }
+  char digits[20];
+  int ndigits = 0;
+  while (p < end && *p != 'e') {
+    if (*p != '.') digits[ndigits++] = *p;
+    p++;
+  }
+  int exponent = 0;
+  std::from_chars(p + 1 + (p[1] == '+'), end, exponent);
+  int decpt = exponent + 1;
+
+  if (decpt > -4 && decpt <= 16) {
+    if (decpt <= 0) {
+      *out++ = '0';
+      *out++ = '.';
+      for (int i = 0; i < -decpt; ++i) *out++ = '0';
+      memcpy(out, digits, ndigits);
+      out += ndigits;
+    } else if (decpt >= ndigits) {
+      memcpy(out, digits, ndigits);
+      out += ndigits;
+      for (int i = ndigits; i < decpt; ++i) *out++ = '0';
+      *out++ = '.';
+      *out++ = '0';
+    } else {
+      memcpy(out, digits, decpt);
+      out += decpt;
+      *out++ = '.';
+      memcpy(out, digits + decpt, ndigits - decpt);
+      out += ndigits - decpt;
+    }
+    return out - buf;
+  }
+
+  *out++ = digits[0];
+  if (ndigits > 1) {
+    *out++ = '.';
+    memcpy(out, digits + 1, ndigits - 1);
+    out += ndigits - 1;
+  }
+  *out++ = 'e';
+  *out++ = exponent < 0 ? '-' : '+';
+  int magnitude = exponent < 0 ? -exponent : exponent;
+  if (magnitude < 10) *out++ = '0';
+  out = std::to_chars(out, out + 4, magnitude).ptr;
+  return out - buf;
+}
+
+size_t formatDouble(char *buf, double value) {
+  if (floatStyle == FloatStyle::REPR) {
+    return formatRepr(buf, value);
+  }
+  return std::to_chars(buf, buf + FLOAT_BUFFER_SIZE, value, std::chars_format::fixed, 6).ptr - buf;
+}
+
+void appendDouble(std::string &out, double value) {
+  char buf[FLOAT_BUFFER_SIZE];
+  out.append(buf, formatDouble(buf, value));
+}
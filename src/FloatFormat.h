@@ -0,0 +1,28 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_FLOATFORMAT_H
+#define PYTHON_INTERPRETER_FLOATFORMAT_H
+
+#include <string>
+#include <cstddef>
+
+// How floats are turned into text by print(), str() and f-strings.
+// FIXED is the assignment's format: always six decimals, like "%f".
+// REPR is CPython's repr(): the shortest digits that round-trip, switching
+// to scientific notation outside 1e-4 <= |x| < 1e16.
+enum class FloatStyle { FIXED, REPR };
+
+void setFloatStyle(FloatStyle style);
+FloatStyle getFloatStyle();
+
+// Large enough for any double in either style (DBL_MAX in FIXED needs 309
+// integral digits, the sign, the point and six decimals).
+const size_t FLOAT_BUFFER_SIZE = 320;
+
+// Write value into buf (at least FLOAT_BUFFER_SIZE bytes) in the current
+// style and return the number of characters written. No terminator is added.
+size_t formatDouble(char *buf, double value);
+
+// Append the formatted value to out.
+void appendDouble(std::string &out, double value);
+
+#endif//PYTHON_INTERPRETER_FLOATFORMAT_H
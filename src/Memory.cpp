@@ -0,0 +1,76 @@
+#include "Memory.h"
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+
+static void raise(std::atomic<long long> &peak, long long value) {
+  long long seen = peak.load(std::memory_order_relaxed);
+  while (value > seen && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+}
+
+void MemoryBudget::chargeTracked(Category category, size_t bytes) {
+  long long now = total.fetch_add((long long)bytes, std::memory_order_relaxed) + (long long)bytes;
+  if (limit && now > (long long)limit) {
+    total.fetch_sub((long long)bytes, std::memory_order_relaxed);
+    fail((double)bytes);
+  }
+  long long mine = used[category].fetch_add((long long)bytes, std::memory_order_relaxed) + (long long)bytes;
+  raise(peaks[category], mine);
+  raise(peakAll, now);
+}
+
+void MemoryBudget::check(double bytes) const {
+  // half the address space is more than any allocation can get
+  if (bytes > (double)(SIZE_MAX / 2)) fail(bytes);
+  if (enabled && limit && (double)total.load(std::memory_order_relaxed) + bytes > (double)limit) fail(bytes);
+}
+
+void MemoryBudget::fail(double bytes) const {
+  // %.0f, as casting sizes past the range of an integer type is undefined
+  char size[400];
+  snprintf(size, sizeof(size), "%.0f", bytes);
+  std::string message = std::string("MemoryError: cannot allocate ") + size + " more bytes";
+  if (limit) message += " within the limit of " + std::to_string(limit) + " bytes";
+  throw std::runtime_error(message);
+}
+
+void MemoryBudget::writeJson(std::ostream &out) const {
+  out << "{\"limit\": ";
+  if (limit) {
+    out << limit;
+  } else {
+    out << "null";
+  }
+  out << ", \"peak\": " << peakTotal() << ", \"peak_by_category\": {";
+  for (int i = 0; i < CATEGORY_COUNT; ++i) {
+    auto category = static_cast<Category>(i);
+    out << (i ? ", " : "") << "\"" << memoryCategoryName(category) << "\": " << peak(category);
+  }
+  out << "}}";
+}
+
+void MemoryBudget::writeReport(std::ostream &out) const {
+  auto mib = [](long long bytes) { return bytes / (1024.0 * 1024.0); };
+  out << std::fixed << std::setprecision(2);
+  out << "[memory] peak " << mib(peakTotal()) << " MiB";
+  if (limit) out << " of a " << mib(limit) << " MiB limit";
+  out << "; peak by category:";
+  for (int i = 0; i < CATEGORY_COUNT; ++i) {
+    auto category = static_cast<Category>(i);
+    out << (i ? ", " : " ") << memoryCategoryName(category) << " " << mib(peak(category)) << " MiB";
+  }
+  out << std::endl;
+}
+
+MemoryBudget &memoryBudget() {
+  static MemoryBudget *budget = new MemoryBudget;
+  return *budget;
+}
+
+const char *memoryCategoryName(MemoryBudget::Category category) {
+  static const char *const names[MemoryBudget::CATEGORY_COUNT] = {"bignum", "strings", "values", "frames",
+                                                                   "parse_tree"};
+  return names[category];
+}
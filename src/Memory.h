@@ -0,0 +1,63 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_MEMORY_H
+#define PYTHON_INTERPRETER_MEMORY_H
+
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+
+// Bytes held through the interpreter's own allocators, by category, with an
+// optional limit. The allocators charge what they take and release what
+// they give back; a charge that would go over the limit throws MemoryError
+// instead, so a runaway script stops with a runtime error rather than being
+// killed. Nothing is counted until enable(), which is cheap to leave off.
+// Safe to charge from any thread.
+class MemoryBudget {
+public:
+  enum Category { BIGNUM, STRINGS, VALUES, FRAMES, PARSE_TREE, CATEGORY_COUNT };
+
+  void enable() { enabled = true; }
+  bool tracking() const { return enabled; }
+  // 0 means no limit.
+  void setLimit(size_t bytes) { limit = bytes; }
+  size_t getLimit() const { return limit; }
+
+  void charge(Category category, size_t bytes) {
+    if (enabled) chargeTracked(category, bytes);
+  }
+  void release(Category category, size_t bytes) {
+    if (!enabled) return;
+    used[category].fetch_sub((long long)bytes, std::memory_order_relaxed);
+    total.fetch_sub((long long)bytes, std::memory_order_relaxed);
+  }
+  // Throw MemoryError if bytes more would not fit, without charging them;
+  // for operations that know their result size before building it. Sizes
+  // no allocation could satisfy fail even without a limit.
+  void check(double bytes) const;
+
+  long long peak(Category category) const { return peaks[category].load(); }
+  long long peakTotal() const { return peakAll.load(); }
+
+  // Peak bytes by category as one JSON object, and as a report for people.
+  void writeJson(std::ostream &out) const;
+  void writeReport(std::ostream &out) const;
+
+private:
+  bool enabled = false;
+  size_t limit = 0;
+  std::atomic<long long> total{0};
+  std::atomic<long long> peakAll{0};
+  std::atomic<long long> used[CATEGORY_COUNT] = {};
+  std::atomic<long long> peaks[CATEGORY_COUNT] = {};
+
+  void chargeTracked(Category category, size_t bytes);
+  [[noreturn]] void fail(double bytes) const;
+};
+
+// The process-wide budget. Never destroyed, so allocators can still
+// release into it while the process exits.
+MemoryBudget &memoryBudget();
+
+const char *memoryCategoryName(MemoryBudget::Category category);
+
+#endif//PYTHON_INTERPRETER_MEMORY_H
@@ -0,0 +1,141 @@
+#include "Output.h"
+#include "FloatFormat.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/uio.h>
+#include <unistd.h>
+
+Output::Output(int fd, size_t capacity) : fd(fd), capacity(capacity) {
+  buffer = new char[capacity];
+  policy = isatty(fd) ? LINE : BLOCK;
+}
+
+Output::~Output() {
+  flush();
+  delete[] buffer;
+}
+
+void Output::setPolicy(FlushPolicy policy_) {
+  policy = policy_;
+}
+
+Output::FlushPolicy Output::getPolicy() const {
+  return policy;
+}
+
+void Output::setCapacity(size_t capacity_) {
+  flush();
+  if (capacity_ == 0) capacity_ = 1;
+  delete[] buffer;
+  buffer = new char[capacity_];
+  capacity = capacity_;
+}
+
+void Output::write(const char *data, size_t size) {
+  if (size <= capacity - length) {
+    memcpy(buffer + length, data, size);
+    length += size;
+    return;
+  }
+  if (size < capacity) {
+    flush();
+    memcpy(buffer, data, size);
+    length = size;
+    return;
+  }
+  // too big to ever fit: send the pending bytes and the data in one writev
+  sent += length + size;
+  struct iovec iov[2];
+  iov[0].iov_base = buffer;
+  iov[0].iov_len = length;
+  iov[1].iov_base = const_cast<char *>(data);
+  iov[1].iov_len = size;
+  int first = length == 0 ? 1 : 0;
+  while (first < 2) {
+    ssize_t written = ::writev(fd, iov + first, 2 - first);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    while (first < 2 && (size_t)written >= iov[first].iov_len) {
+      written -= iov[first].iov_len;
+      first++;
+    }
+    if (first < 2) {
+      iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + written;
+      iov[first].iov_len -= written;
+    }
+  }
+  length = 0;
+}
+
+void Output::writeEscaped(const char *data, size_t size) {
+  size_t start = 0;
+  for (size_t i = 0; i + 1 < size; ++i) {
+    if (data[i] != '\\') continue;
+    char translated;
+    switch (data[i + 1]) {
+      case 'n': translated = '\n'; break;
+      case 't': translated = '\t'; break;
+      case 'r': translated = '\r'; break;
+      case '\\': translated = '\\'; break;
+      case '\"': translated = '\"'; break;
+      default: continue;
+    }
+    write(data + start, i - start);
+    put(translated);
+    start = ++i + 1;
+  }
+  write(data + start, size - start);
+}
+
+void Output::writeInt(const sjtu::int2048 &value) {
+  size_t needed = value.decimal_size();
+  if (needed > capacity) {
+    std::string tmp;
+    value.append_to(tmp);
+    write(tmp);
+    return;
+  }
+  char *begin = reserve(needed);
+  commit(value.write_decimal(begin) - begin);
+}
+
+void Output::writeDouble(double value) {
+  char *begin = reserve(FLOAT_BUFFER_SIZE);
+  commit(formatDouble(begin, value));
+}
+
+void Output::endLine() {
+  put('\n');
+  if (policy == LINE) flush();
+}
+
+void Output::flush() {
+  sent += length;
+  writeAll(buffer, length);
+  length = 0;
+}
+
+char *Output::reserve(size_t size) {
+  if (size > capacity - length) flush();
+  if (size > capacity) setCapacity(size);
+  return buffer + length;
+}
+
+void Output::writeAll(const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t written = ::write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    data += written;
+    size -= written;
+  }
+}
+
+Output &output() {
+  static Output out(1);
+  return out;
+}
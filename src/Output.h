@@ -0,0 +1,77 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_OUTPUT_H
+#define PYTHON_INTERPRETER_OUTPUT_H
+
+#include <string>
+#include <cstddef>
+#include "int2048.h"
+
+// Buffered writer for the interpreter's standard output.
+// Everything print() produces goes through here instead of std::cout:
+// bytes are collected in a large user-space buffer and handed to fd 1 with
+// write/writev, so there is no iostream or stdio synchronisation per call.
+class Output {
+public:
+  // LINE flushes after every completed line (interactive use),
+  // BLOCK flushes only when the buffer fills up, at exit or on error.
+  enum FlushPolicy { LINE, BLOCK };
+
+  static const size_t DEFAULT_CAPACITY = 1 << 16;
+
+  explicit Output(int fd = 1, size_t capacity = DEFAULT_CAPACITY);
+  ~Output();
+
+  Output(const Output &) = delete;
+  Output &operator=(const Output &) = delete;
+
+  void setPolicy(FlushPolicy policy);
+  FlushPolicy getPolicy() const;
+
+  // Resize the buffer. Pending bytes are flushed first.
+  void setCapacity(size_t capacity);
+
+  void put(char c) {
+    if (length == capacity) flush();
+    buffer[length++] = c;
+  }
+  void write(const char *data, size_t size);
+  void write(const std::string &str) { write(str.data(), str.size()); }
+
+  // Write a string as print() shows it: the escapes \n \t \r \\ and \"
+  // that survive in string values are translated on the way out.
+  void writeEscaped(const char *data, size_t size);
+
+  // Format numbers straight into the buffer.
+  void writeInt(const sjtu::int2048 &value);
+  void writeDouble(double value);
+
+  // Terminate the current line, flushing it under the LINE policy.
+  void endLine();
+
+  // Hand all pending bytes to the file descriptor.
+  void flush();
+
+  // Bytes written so far, pending ones included.
+  unsigned long long bytesWritten() const { return sent + length; }
+
+  // Make room for at least size bytes and return where to write them;
+  // commit(size) then makes them part of the output.
+  char *reserve(size_t size);
+  void commit(size_t size) { length += size; }
+
+private:
+  int fd;
+  char *buffer;
+  size_t capacity;
+  size_t length = 0;
+  // bytes handed to writeAll or writev
+  unsigned long long sent = 0;
+  FlushPolicy policy;
+
+  void writeAll(const char *data, size_t size);
+};
+
+// The process-wide stdout writer. It is flushed when the process exits.
+Output &output();
+
+#endif//PYTHON_INTERPRETER_OUTPUT_H
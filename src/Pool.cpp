@@ -0,0 +1,28 @@
+#include "Pool.h"
+#include "Memory.h"
+
+void *SlabPool::carve(size_t bytes) {
+  if (limit - cursor < (ptrdiff_t)bytes) {
+    // the rest of the old slab is too small for this class; leave it
+    memoryBudget().charge(MemoryBudget::VALUES, SLAB_BYTES);
+    cursor = static_cast<char *>(::operator new(SLAB_BYTES));
+    limit = cursor + SLAB_BYTES;
+    slabs.push_back(cursor);
+  }
+  void *object = cursor;
+  cursor += bytes;
+  return object;
+}
+
+void SlabPool::writeJson(std::ostream &out) const {
+  out << "{\"slabs\": " << slabs.size() << ", \"slab_bytes\": " << SLAB_BYTES << ", \"classes\": [";
+  bool first = true;
+  for (size_t c = 0; c < CLASSES; ++c) {
+    const ClassStats &counts = classStats[c];
+    if (!counts.allocations) continue;
+    out << (first ? "" : ", ") << "{\"bytes\": " << (c + 1) * GRANULE << ", \"allocations\": " << counts.allocations
+        << ", \"reused\": " << counts.reused << ", \"live\": " << counts.live << ", \"peak\": " << counts.peak << "}";
+    first = false;
+  }
+  out << "]}";
+}
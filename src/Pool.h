@@ -0,0 +1,106 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_POOL_H
+#define PYTHON_INTERPRETER_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <ostream>
+#include <vector>
+
+// Size-class free lists for the small objects the engines allocate in bulk:
+// Value payload boxes and the nodes of the tree engine's scopes. Objects are
+// carved from SLAB_BYTES slabs; a freed object goes on the free list of its
+// class and is handed out again before the slab is touched. Slabs are never
+// given back. Not thread-safe; interpreter thread only.
+class SlabPool {
+public:
+  static const size_t GRANULE = 16;
+  // classes of 16, 32, ... 128 bytes; larger objects use operator new
+  static const size_t CLASSES = 8;
+  static const size_t SLAB_BYTES = 64 * 1024;
+
+  struct ClassStats {
+    uint64_t allocations = 0;
+    // allocations served from the free list
+    uint64_t reused = 0;
+    uint64_t live = 0;
+    uint64_t peak = 0;
+  };
+
+  SlabPool() = default;
+  SlabPool(const SlabPool &) = delete;
+  SlabPool &operator=(const SlabPool &) = delete;
+
+  void *allocate(size_t size) {
+    size_t c = (size + GRANULE - 1) / GRANULE - 1;
+    if (c >= CLASSES) return ::operator new(size);
+    ClassStats &counts = classStats[c];
+    void *object;
+    if (FreeObject *head = freeLists[c]) {
+      freeLists[c] = head->next;
+      counts.reused++;
+      object = head;
+    } else {
+      object = carve((c + 1) * GRANULE);
+    }
+    counts.allocations++;
+    if (++counts.live > counts.peak) counts.peak = counts.live;
+    return object;
+  }
+
+  void deallocate(void *p, size_t size) {
+    size_t c = (size + GRANULE - 1) / GRANULE - 1;
+    if (c >= CLASSES) {
+      ::operator delete(p);
+      return;
+    }
+    classStats[c].live--;
+    auto object = static_cast<FreeObject *>(p);
+    object->next = freeLists[c];
+    freeLists[c] = object;
+  }
+
+  // Slab count and per-class counters as a JSON object.
+  void writeJson(std::ostream &out) const;
+
+private:
+  struct FreeObject {
+    FreeObject *next;
+  };
+  FreeObject *freeLists[CLASSES] = {};
+  ClassStats classStats[CLASSES];
+  // the unused part of the newest slab
+  char *cursor = nullptr;
+  char *limit = nullptr;
+  std::vector<char *> slabs;
+
+  void *carve(size_t bytes);
+};
+
+// The pool behind Value payloads and tree-engine scopes. It is never
+// destroyed, so values released during exit can still be returned to it.
+inline SlabPool &valuePool() {
+  static SlabPool *pool = new SlabPool;
+  return *pool;
+}
+
+// STL allocator on valuePool(), for node-based containers.
+template <typename T>
+struct PoolAllocator {
+  using value_type = T;
+
+  PoolAllocator() = default;
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U> &) {}
+
+  T *allocate(size_t n) { return static_cast<T *>(valuePool().allocate(n * sizeof(T))); }
+  void deallocate(T *p, size_t n) { valuePool().deallocate(p, n * sizeof(T)); }
+
+  template <typename U>
+  bool operator==(const PoolAllocator<U> &) const { return true; }
+  template <typename U>
+  bool operator!=(const PoolAllocator<U> &) const { return false; }
+};
+
+#endif//PYTHON_INTERPRETER_POOL_H
@@ -0,0 +1,136 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <stdexcept>
+#include <sys/time.h>
+
+std::atomic<int> Profiler::pending{0};
+
+Profiler::Profiler(std::string source) : source(std::move(source)) {
+  lineStarts.push_back(0);
+  for (size_t i = 0; i < this->source.size(); ++i) {
+    if (this->source[i] == '\n') lineStarts.push_back(i + 1);
+  }
+}
+
+Profiler::~Profiler() {
+  stop();
+}
+
+void Profiler::onSignal(int) {
+  pending.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Profiler::start() {
+  if (running) return;
+  struct sigaction action = {};
+  action.sa_handler = &Profiler::onSignal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, nullptr) != 0) {
+    throw std::runtime_error("cannot install the profiling signal handler");
+  }
+  struct itimerval timer = {};
+  timer.it_interval.tv_usec = INTERVAL_USEC;
+  timer.it_value.tv_usec = INTERVAL_USEC;
+  if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+    throw std::runtime_error("cannot start the profiling timer");
+  }
+  pending.store(0);
+  running = true;
+}
+
+void Profiler::stop() {
+  if (!running) return;
+  struct itimerval timer = {};
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  signal(SIGPROF, SIG_IGN);
+  running = false;
+}
+
+int Profiler::function(const std::string &name) {
+  auto it = functionIds.find(name);
+  if (it != functionIds.end()) return it->second;
+  functions.emplace_back();
+  functions.back().name = name;
+  functionIds.emplace(name, (int)functions.size() - 1);
+  return (int)functions.size() - 1;
+}
+
+void Profiler::sample() {
+  uint64_t count = pending.exchange(0, std::memory_order_relaxed);
+  if (count == 0 || stack.empty()) return;
+  samples += count;
+  std::vector<int> key;
+  key.reserve(stack.size() * 2);
+  for (auto &frame : stack) {
+    key.push_back(frame.function);
+    key.push_back(frame.line);
+    FunctionStats &stats = functions[frame.function];
+    if (stats.lastSample != samples) {
+      stats.lastSample = samples;
+      stats.inclusive += count;
+    }
+  }
+  stacks[key] += count;
+  functions[stack.back().function].exclusive += count;
+  lines[stack.back().line].samples += count;
+}
+
+std::string Profiler::lineText(int line) const {
+  if (line < 1 || (size_t)line > lineStarts.size()) return "";
+  size_t start = lineStarts[line - 1];
+  size_t end = source.find('\n', start);
+  std::string text = source.substr(start, end == std::string::npos ? std::string::npos : end - start);
+  size_t first = text.find_first_not_of(" \t");
+  size_t last = text.find_last_not_of(" \t\r");
+  return first == std::string::npos ? "" : text.substr(first, last - first + 1);
+}
+
+void Profiler::writeReport(std::ostream &out) const {
+  double ms = INTERVAL_USEC / 1000.0;
+  char row[256];
+  out << "profile: " << samples << " samples, " << ms << " ms of CPU time each\n\n";
+
+  std::vector<int> order;
+  for (size_t i = 0; i < lines.size(); ++i) {
+    if (lines[i].hits) order.push_back(i);
+  }
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    if (lines[a].samples != lines[b].samples) return lines[a].samples > lines[b].samples;
+    if (lines[a].hits != lines[b].hits) return lines[a].hits > lines[b].hits;
+    return a < b;
+  });
+  out << "    line         hits    time(ms)      %  source\n";
+  for (int line : order) {
+    const LineStats &stats = lines[line];
+    snprintf(row, sizeof(row), "%8d %12llu %11.1f %6.1f  ", line, (unsigned long long)stats.hits,
+             stats.samples * ms, samples ? 100.0 * stats.samples / samples : 0.0);
+    out << row << lineText(line) << '\n';
+  }
+
+  std::vector<const FunctionStats *> byTime;
+  for (auto &stats : functions) byTime.push_back(&stats);
+  std::stable_sort(byTime.begin(), byTime.end(), [](const FunctionStats *a, const FunctionStats *b) {
+    if (a->inclusive != b->inclusive) return a->inclusive > b->inclusive;
+    return a->exclusive > b->exclusive;
+  });
+  out << "\nfunction                        calls   incl(ms)   excl(ms)\n";
+  for (auto stats : byTime) {
+    snprintf(row, sizeof(row), "%-24s %12llu %10.1f %10.1f\n", stats->name.c_str(),
+             (unsigned long long)stats->calls, stats->inclusive * ms, stats->exclusive * ms);
+    out << row;
+  }
+}
+
+void Profiler::writeCollapsed(std::ostream &out) const {
+  for (auto &entry : stacks) {
+    const std::vector<int> &key = entry.first;
+    for (size_t i = 0; i < key.size(); i += 2) {
+      if (i) out << ';';
+      out << functions[key[i]].name << ':' << key[i + 1];
+    }
+    out << ' ' << entry.second << '\n';
+  }
+}
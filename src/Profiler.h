@@ -0,0 +1,99 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_PROFILER_H
+#define PYTHON_INTERPRETER_PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Statement-level sampling profiler. The engines report every line they
+// start and every user function they enter and leave; a SIGPROF timer
+// marks a sample due once per INTERVAL_USEC of CPU time, and the next
+// time a line is reported the sample is charged to the line that was
+// running and its call stack. Between samples the cost is a counter increment and an
+// atomic load per line.
+class Profiler {
+public:
+  static const int INTERVAL_USEC = 1000;
+
+  // source is the script text, used to show the lines in the report.
+  explicit Profiler(std::string source);
+  ~Profiler();
+  Profiler(const Profiler &) = delete;
+  Profiler &operator=(const Profiler &) = delete;
+
+  // Start and stop the sampling timer. Only one profiler can run at a time.
+  void start();
+  void stop();
+
+  // The id of the function called name, for enter().
+  int function(const std::string &name);
+
+  void enter(int function) {
+    stack.push_back(Frame{function, 0});
+    ++functions[function].calls;
+  }
+  void leave() { stack.pop_back(); }
+
+  // The running frame is now at line. Consecutive reports of the same line
+  // count as one execution of it.
+  void line(int line) {
+    Frame &top = stack.back();
+    // a sample that fell due since the last report belongs to the line
+    // that was running then; a frame that has not started waits for one
+    if (top.line && pending.load(std::memory_order_relaxed)) sample();
+    if (line != top.line) {
+      top.line = line;
+      if ((size_t)line >= lines.size()) lines.resize(line + 1);
+      ++lines[line].hits;
+    }
+  }
+
+  // Lines and functions by descending time.
+  void writeReport(std::ostream &out) const;
+  // One "function:line;...;function:line samples" row per distinct stack,
+  // the input format of flamegraph.pl.
+  void writeCollapsed(std::ostream &out) const;
+
+private:
+  struct Frame {
+    int function;
+    int line;
+  };
+  struct FunctionStats {
+    std::string name;
+    uint64_t calls = 0;
+    uint64_t inclusive = 0;
+    uint64_t exclusive = 0;
+    // the last sample counted in inclusive, so recursion counts once
+    uint64_t lastSample = 0;
+  };
+  struct LineStats {
+    uint64_t hits = 0;
+    uint64_t samples = 0;
+  };
+
+  std::string source;
+  // offset of the first character of each line
+  std::vector<size_t> lineStarts;
+  std::vector<FunctionStats> functions;
+  std::unordered_map<std::string, int> functionIds;
+  std::vector<LineStats> lines;
+  std::vector<Frame> stack;
+  // function and line of every frame, outermost first
+  std::map<std::vector<int>, uint64_t> stacks;
+  uint64_t samples = 0;
+  bool running = false;
+
+  // samples due, set from the signal handler
+  static std::atomic<int> pending;
+  static void onSignal(int);
+  void sample();
+  std::string lineText(int line) const;
+};
+
+#endif//PYTHON_INTERPRETER_PROFILER_H
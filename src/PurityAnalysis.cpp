@@ -0,0 +1,173 @@
+#include "PurityAnalysis.h"
+#include "Bytecode.h"
+
+std::unordered_set<const ast::FuncDef *> PurityAnalysis::run(const ast::Program &program) {
+  functions.clear();
+  defCount.clear();
+  globals.clear();
+  collect(program.body, nullptr);
+
+  std::unordered_map<std::string, const Function *> byName;
+  for (auto &function : functions) {
+    for (auto &name : function.assigned) {
+      if (!function.parameters.count(name) && globals.count(name)) function.impure = true;
+    }
+    for (auto &name : function.read) {
+      bool local = function.parameters.count(name) || (function.assigned.count(name) && !globals.count(name));
+      if (!local) function.impure = true;
+    }
+    for (auto &callee : function.callees) {
+      // an undefined callee is fine if it falls back to a (pure) library builtin
+      bool library = defCount[callee] == 0 && findBuiltin(callee, true) != Builtin::BUILTIN_COUNT;
+      if (defCount[callee] != 1 && !library) function.impure = true;
+    }
+    byName[function.def->name] = &function;
+  }
+
+  // drop functions that call an impure one until nothing changes
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto &function : functions) {
+      if (function.impure) continue;
+      for (auto &callee : function.callees) {
+        auto found = byName.find(callee);
+        if (found != byName.end() && found->second->impure) {
+          function.impure = true;
+          changed = true;
+          break;
+        }
+      }
+    }
+  }
+
+  std::unordered_set<const ast::FuncDef *> pure;
+  for (auto &function : functions) {
+    if (!function.impure) pure.insert(function.def);
+  }
+  return pure;
+}
+
+// function is the innermost enclosing function, or nullptr at top level.
+void PurityAnalysis::collect(const ast::Suite &suite, Function *function) {
+  for (auto stmt : suite) {
+    switch (stmt->kind) {
+      case ast::Stmt::EXPR:
+        collectExprs(static_cast<const ast::ExprStmt *>(stmt)->values, function);
+        break;
+      case ast::Stmt::ASSIGN: {
+        auto assignStmt = static_cast<const ast::AssignStmt *>(stmt);
+        collectExprs(assignStmt->values, function);
+        for (auto &targets : assignStmt->targets) {
+          for (auto &name : targets) assign(name, function);
+        }
+        break;
+      }
+      case ast::Stmt::AUGASSIGN: {
+        auto augStmt = static_cast<const ast::AugAssignStmt *>(stmt);
+        collectExprs(augStmt->values, function);
+        for (auto &name : augStmt->targets) {
+          // name op= value also reads name
+          if (function) function->read.insert(name);
+          assign(name, function);
+        }
+        break;
+      }
+      case ast::Stmt::IF: {
+        auto ifStmt = static_cast<const ast::IfStmt *>(stmt);
+        collectExprs(ifStmt->conditions, function);
+        for (auto &body : ifStmt->bodies) collect(body, function);
+        collect(ifStmt->orelse, function);
+        break;
+      }
+      case ast::Stmt::WHILE: {
+        auto whileStmt = static_cast<const ast::WhileStmt *>(stmt);
+        collectExpr(whileStmt->condition, function);
+        collect(whileStmt->body, function);
+        break;
+      }
+      case ast::Stmt::FUNCDEF: {
+        auto def = static_cast<const ast::FuncDef *>(stmt);
+        // defaults are evaluated in the defining scope
+        for (auto &param : def->parameters) {
+          if (param.defaultValue) collectExpr(param.defaultValue, function);
+        }
+        if (function) function->impure = true;
+        defCount[def->name]++;
+        functions.emplace_back();
+        functions.back().def = def;
+        for (auto &param : def->parameters) {
+          functions.back().parameters.insert(param.name);
+        }
+        // functions may grow while the body is collected, so work on a copy
+        Function inner = std::move(functions.back());
+        size_t index = functions.size() - 1;
+        collect(def->body, &inner);
+        functions[index] = std::move(inner);
+        break;
+      }
+      case ast::Stmt::RETURN:
+        collectExprs(static_cast<const ast::ReturnStmt *>(stmt)->values, function);
+        break;
+      case ast::Stmt::BREAK:
+      case ast::Stmt::CONTINUE:
+        break;
+    }
+  }
+}
+
+void PurityAnalysis::collectExprs(const ast::List<ast::Expr *> &exprs, Function *function) {
+  for (auto expr : exprs) {
+    collectExpr(expr, function);
+  }
+}
+
+void PurityAnalysis::collectExpr(const ast::Expr *expr, Function *function) {
+  switch (expr->kind) {
+    case ast::Expr::NAME:
+      if (function) function->read.insert(static_cast<const ast::NameExpr *>(expr)->name);
+      break;
+    case ast::Expr::CONSTANT:
+      break;
+    case ast::Expr::FSTRING:
+      for (auto &slot : static_cast<const ast::FStringExpr *>(expr)->slots) {
+        collectExprs(slot, function);
+      }
+      break;
+    case ast::Expr::UNARY:
+      collectExpr(static_cast<const ast::UnaryExpr *>(expr)->operand, function);
+      break;
+    case ast::Expr::BINARY: {
+      auto binary = static_cast<const ast::BinaryExpr *>(expr);
+      collectExpr(binary->left, function);
+      collectExpr(binary->right, function);
+      break;
+    }
+    case ast::Expr::COMPARE:
+      collectExprs(static_cast<const ast::CompareExpr *>(expr)->operands, function);
+      break;
+    case ast::Expr::BOOLEAN:
+      collectExprs(static_cast<const ast::BooleanExpr *>(expr)->operands, function);
+      break;
+    case ast::Expr::CALL: {
+      auto call = static_cast<const ast::CallExpr *>(expr);
+      collectExprs(call->args, function);
+      if (!function) break;
+      Builtin builtin = findBuiltin(call->name);
+      if (builtin == Builtin::PRINT) {
+        function->impure = true;
+      } else if (builtin == Builtin::BUILTIN_COUNT) {
+        function->callees.insert(call->name);
+      }
+      break;
+    }
+  }
+}
+
+void PurityAnalysis::assign(const std::string &name, Function *function) {
+  if (function) {
+    function->assigned.insert(name);
+  } else {
+    globals.insert(name);
+  }
+}
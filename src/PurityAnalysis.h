@@ -0,0 +1,46 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_PURITYANALYSIS_H
+#define PYTHON_INTERPRETER_PURITYANALYSIS_H
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Ast.h"
+
+// Finds the functions whose result depends only on their arguments, so that
+// the VM may memoize them (--memoize). A function is pure if
+//   - it reads and writes only its own names: parameters, and locals that
+//     no top-level statement assigns. Only top-level assignments can bind
+//     a global, so any other name can never fall through to a global;
+//   - it defines no functions and does not call print();
+//   - every user function it calls is pure and is the only def of its name,
+//     so the call cannot reach a different function at run time.
+// Recursion is allowed: the pure set is the largest one closed under these
+// rules.
+class PurityAnalysis {
+public:
+  std::unordered_set<const ast::FuncDef *> run(const ast::Program &program);
+
+private:
+  struct Function {
+    const ast::FuncDef *def;
+    std::unordered_set<std::string> parameters;
+    std::unordered_set<std::string> assigned;
+    std::unordered_set<std::string> read;
+    std::unordered_set<std::string> callees;
+    bool impure = false;
+  };
+
+  std::vector<Function> functions;
+  std::unordered_map<std::string, int> defCount;
+  // names assigned by top-level statements: the only globals there can be
+  std::unordered_set<std::string> globals;
+
+  void collect(const ast::Suite &suite, Function *function);
+  void collectExprs(const ast::List<ast::Expr *> &exprs, Function *function);
+  void collectExpr(const ast::Expr *expr, Function *function);
+  void assign(const std::string &name, Function *function);
+};
+
+#endif//PYTHON_INTERPRETER_PURITYANALYSIS_H
@@ -0,0 +1,299 @@
+#include "ScriptCache.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Bump whenever the instruction set or the file layout changes.
+static const uint32_t CACHE_VERSION = 5;
+static const char CACHE_MAGIC[4] = {'P', 'Y', 'I', 'C'};
+
+// Followed by the sourceSize bytes of the source itself, which a hit must
+// match exactly: the hash only picks the file.
+struct CacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t hash;
+  uint64_t sourceSize;
+};
+
+namespace {
+
+class Writer {
+public:
+  std::string bytes;
+
+  template <typename T>
+  void put(const T &value) {
+    bytes.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+  void putString(const std::string &str) {
+    put<uint32_t>(str.size());
+    bytes += str;
+  }
+  void align() {
+    while (bytes.size() % 4) bytes += '\0';
+  }
+};
+
+// Reads from the mapped file; every read is bounds-checked and a failed
+// one leaves ok false, which turns the whole load into a miss.
+class Reader {
+public:
+  Reader(const char *begin, size_t size) : begin(begin), pos(0), size(size) {}
+
+  bool ok = true;
+
+  const char *take(size_t count) {
+    if (!ok || count > size - pos) {
+      ok = false;
+      return nullptr;
+    }
+    const char *p = begin + pos;
+    pos += count;
+    return p;
+  }
+  template <typename T>
+  T get() {
+    T value{};
+    if (auto p = take(sizeof(T))) memcpy(&value, p, sizeof(T));
+    return value;
+  }
+  std::string getString() {
+    uint32_t length = get<uint32_t>();
+    const char *p = take(length);
+    return p ? std::string(p, length) : std::string();
+  }
+  void align() {
+    size_t padding = (4 - pos % 4) % 4;
+    take(padding);
+  }
+  bool atEnd() const { return ok && pos == size; }
+
+private:
+  const char *begin;
+  size_t pos;
+  size_t size;
+};
+
+}
+
+static bool writeConstant(Writer &out, const Value &value) {
+  out.put<uint8_t>(value.type());
+  switch (value.type()) {
+    case Value::NONE:
+      return true;
+    case Value::BOOL:
+      out.put<uint8_t>(value.asBool());
+      return true;
+    case Value::INT: {
+      const sjtu::int2048 &number = value.asInt();
+      out.put<int32_t>(number.sign);
+      out.put<uint32_t>(number.s.size());
+      for (int limb : number.s) out.put<int32_t>(limb);
+      return true;
+    }
+    case Value::FLOAT:
+      out.put<double>(value.asFloat());
+      return true;
+    case Value::STR:
+      out.putString(value.asStr());
+      return true;
+    default:
+      return false;
+  }
+}
+
+static Value readConstant(Reader &in) {
+  switch (in.get<uint8_t>()) {
+    case Value::NONE:
+      return Value(None{});
+    case Value::BOOL:
+      return Value(in.get<uint8_t>() != 0);
+    case Value::INT: {
+      sjtu::int2048 number;
+      number.sign = in.get<int32_t>();
+      uint32_t count = in.get<uint32_t>();
+      if (!in.ok || count > (1u << 28)) {
+        in.ok = false;
+        return Value();
+      }
+      number.s.resize(count);
+      for (uint32_t i = 0; i < count && in.ok; ++i) {
+        number.s[i] = in.get<int32_t>();
+        if (number.s[i] < 0 || number.s[i] >= sjtu::int2048::BASE) in.ok = false;
+      }
+      if (number.sign < -1 || number.sign > 1 || (number.sign == 0) != number.s.empty()) in.ok = false;
+      return Value(std::move(number));
+    }
+    case Value::FLOAT:
+      return Value(in.get<double>());
+    case Value::STR:
+      return Value(in.getString());
+    default:
+      in.ok = false;
+      return Value();
+  }
+}
+
+ScriptCache::ScriptCache(std::string directory) : directory(std::move(directory)) {}
+
+std::string ScriptCache::defaultDirectory() {
+  const char *env = getenv("PYI_CACHE_DIR");
+  return env ? env : "";
+}
+
+uint64_t ScriptCache::hashSource(const char *data, size_t size) {
+  uint64_t hash = 14695981039346656037ull;
+  hash ^= CACHE_VERSION;
+  hash *= 1099511628211ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+std::string ScriptCache::pathFor(uint64_t hash) const {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.pyc", (unsigned long long)hash);
+  return directory + "/" + name;
+}
+
+std::unique_ptr<Module> ScriptCache::load(const char *source, size_t size) const {
+  uint64_t hash = hashSource(source, size);
+  int fd = ::open(pathFor(hash).c_str(), O_RDONLY);
+  if (fd < 0) return nullptr;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CacheHeader)) {
+    ::close(fd);
+    return nullptr;
+  }
+  size_t length = st.st_size;
+  void *addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) return nullptr;
+  std::shared_ptr<const void> backing(addr, [length](const void *p) { munmap(const_cast<void *>(p), length); });
+
+  Reader in(static_cast<const char *>(addr), length);
+  auto header = in.get<CacheHeader>();
+  if (memcmp(header.magic, CACHE_MAGIC, 4) != 0 || header.version != CACHE_VERSION || header.hash != hash ||
+      header.sourceSize != size) {
+    return nullptr;
+  }
+  const char *cachedSource = in.take(size);
+  if (!cachedSource || memcmp(cachedSource, source, size) != 0) return nullptr;
+
+  auto module = std::make_unique<Module>();
+  module->backing = backing;
+  uint32_t count = in.get<uint32_t>();
+  for (uint32_t i = 0; i < count && in.ok; ++i) {
+    module->constants.push_back(readConstant(in));
+  }
+  count = in.get<uint32_t>();
+  for (uint32_t i = 0; i < count && in.ok; ++i) {
+    module->globals.push_back(in.getString());
+  }
+  count = in.get<uint32_t>();
+  for (uint32_t i = 0; i < count && in.ok; ++i) {
+    module->names.push_back(in.getString());
+  }
+  count = in.get<uint32_t>();
+  for (uint32_t i = 0; i < count && in.ok; ++i) {
+    CallSite site;
+    site.name = in.get<int32_t>();
+    uint32_t argc = in.get<uint32_t>();
+    for (uint32_t j = 0; j < argc && in.ok; ++j) {
+      site.keywords.push_back(in.get<int32_t>());
+    }
+    module->callSites.push_back(std::move(site));
+  }
+  count = in.get<uint32_t>();
+  for (uint32_t i = 0; i < count && in.ok; ++i) {
+    CodeObject code;
+    code.name = in.getString();
+    uint32_t locals = in.get<uint32_t>();
+    for (uint32_t j = 0; j < locals && in.ok; ++j) {
+      code.locals.push_back(in.getString());
+    }
+    code.numParams = in.get<uint32_t>();
+    code.numDefaults = in.get<uint32_t>();
+    code.pure = in.get<uint8_t>() != 0;
+    code.size = in.get<uint32_t>();
+    in.align();
+    code.code = reinterpret_cast<const Instruction *>(in.take((size_t)code.size * sizeof(Instruction)));
+    code.lines = reinterpret_cast<const int32_t *>(in.take((size_t)code.size * sizeof(int32_t)));
+    module->codes.push_back(std::move(code));
+  }
+  if (!in.atEnd() || !module->validate()) return nullptr;
+  return module;
+}
+
+bool ScriptCache::store(const char *source, size_t size, const Module &module) const {
+  uint64_t hash = hashSource(source, size);
+  Writer out;
+  CacheHeader header;
+  memcpy(header.magic, CACHE_MAGIC, 4);
+  header.version = CACHE_VERSION;
+  header.hash = hash;
+  header.sourceSize = size;
+  out.put(header);
+  out.bytes.append(source, size);
+
+  out.put<uint32_t>(module.constants.size());
+  for (auto &value : module.constants) {
+    if (!writeConstant(out, value)) return false;
+  }
+  out.put<uint32_t>(module.globals.size());
+  for (auto &name : module.globals) out.putString(name);
+  out.put<uint32_t>(module.names.size());
+  for (auto &name : module.names) out.putString(name);
+  out.put<uint32_t>(module.callSites.size());
+  for (auto &site : module.callSites) {
+    out.put<int32_t>(site.name);
+    out.put<uint32_t>(site.keywords.size());
+    for (auto keyword : site.keywords) out.put<int32_t>(keyword);
+  }
+  out.put<uint32_t>(module.codes.size());
+  for (auto &code : module.codes) {
+    out.putString(code.name);
+    out.put<uint32_t>(code.locals.size());
+    for (auto &name : code.locals) out.putString(name);
+    out.put<uint32_t>(code.numParams);
+    out.put<uint32_t>(code.numDefaults);
+    out.put<uint8_t>(code.pure);
+    out.put<uint32_t>(code.size);
+    out.align();
+    out.bytes.append(reinterpret_cast<const char *>(code.code), (size_t)code.size * sizeof(Instruction));
+    out.bytes.append(reinterpret_cast<const char *>(code.lines), (size_t)code.size * sizeof(int32_t));
+  }
+
+  if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) return false;
+  std::string path = pathFor(hash);
+  std::string temp = path + "." + std::to_string(getpid()) + ".tmp";
+  int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+  const char *data = out.bytes.data();
+  size_t remaining = out.bytes.size();
+  while (remaining > 0) {
+    ssize_t written = ::write(fd, data, remaining);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      ::close(fd);
+      unlink(temp.c_str());
+      return false;
+    }
+    data += written;
+    remaining -= written;
+  }
+  ::close(fd);
+  if (rename(temp.c_str(), path.c_str()) != 0) {
+    unlink(temp.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_SCRIPTCACHE_H
+#define PYTHON_INTERPRETER_SCRIPTCACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "Bytecode.h"
+
+// On-disk cache of compiled scripts.
+// A Module is stored as <directory>/<hash>.pyc, where hash is the FNV-1a
+// hash of the source text. The entry keeps a copy of the source, and only
+// an entry whose source matches byte for byte is a hit. Loading maps the
+// file and lets the instruction arrays point straight into the mapping, so
+// a hit costs one mmap, a compare and a validation pass instead of lexing,
+// parsing and compiling.
+class ScriptCache {
+public:
+  explicit ScriptCache(std::string directory);
+
+  // The directory named by $PYI_CACHE_DIR, or "" if it is not set.
+  static std::string defaultDirectory();
+
+  static uint64_t hashSource(const char *data, size_t size);
+
+  // The cached module for this source, or nullptr on a miss or if the
+  // entry is stale or damaged.
+  std::unique_ptr<Module> load(const char *source, size_t size) const;
+
+  // Save the module for this source. The entry is written to a temporary
+  // file and renamed into place, so concurrent runs never see half a file.
+  // Returns false if the cache directory is not writable.
+  bool store(const char *source, size_t size, const Module &module) const;
+
+private:
+  std::string directory;
+
+  std::string pathFor(uint64_t hash) const;
+};
+
+#endif//PYTHON_INTERPRETER_SCRIPTCACHE_H
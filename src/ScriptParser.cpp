@@ -0,0 +1,460 @@
+#include "ScriptParser.h"
+#include <stdexcept>
+
+ScriptParser::ScriptParser(const char *data, size_t size) : source(data), size(size) {}
+
+bool ScriptParser::accept(TokenType type) {
+  if (tokens[pos].type != type) return false;
+  pos++;
+  return true;
+}
+
+const Token &ScriptParser::expect(TokenType type, const char *what) {
+  if (tokens[pos].type != type) fail(what);
+  return tokens[pos++];
+}
+
+std::string ScriptParser::text(const Token &token) const {
+  return std::string(source + token.start, token.length);
+}
+
+void ScriptParser::fail(const char *what) const {
+  throw std::runtime_error(std::string("SyntaxError: expected ") + what + " (line " + std::to_string(peek().line) + ")");
+}
+
+bool ScriptParser::startsTest() const {
+  switch (peek().type) {
+    case TokenType::STRING:
+    case TokenType::NUMBER:
+    case TokenType::NOT:
+    case TokenType::NONE:
+    case TokenType::TRUE:
+    case TokenType::FALSE:
+    case TokenType::NAME:
+    case TokenType::OPEN_PAREN:
+    case TokenType::ADD:
+    case TokenType::MINUS:
+    case TokenType::FORMAT_START:
+      return true;
+    default:
+      return false;
+  }
+}
+
+std::unique_ptr<ast::Program> ScriptParser::parse() {
+  tokens = Tokenizer(source, size).tokenize();
+  pos = 0;
+  auto result = std::make_unique<ast::Program>();
+  program = result.get();
+  // file_input: (NEWLINE | stmt)* EOF
+  std::vector<ast::Stmt *> body;
+  while (!check(TokenType::END)) {
+    if (accept(TokenType::NEWLINE)) continue;
+    parseStmt(body);
+  }
+  program->body = program->list(std::move(body));
+  program = nullptr;
+  return result;
+}
+
+void ScriptParser::parseStmt(std::vector<ast::Stmt *> &out) {
+  switch (peek().type) {
+    case TokenType::IF:
+      out.push_back(parseIf());
+      break;
+    case TokenType::WHILE:
+      out.push_back(parseWhile());
+      break;
+    case TokenType::DEF:
+      out.push_back(parseFuncDef());
+      break;
+    default:
+      out.push_back(parseSimpleStmt());
+      break;
+  }
+}
+
+ast::Stmt *ScriptParser::parseSimpleStmt() {
+  ast::Stmt *stmt;
+  if (check(TokenType::BREAK) || check(TokenType::CONTINUE) || check(TokenType::RETURN)) {
+    stmt = parseFlowStmt();
+  } else {
+    stmt = parseExprStmt();
+  }
+  expect(TokenType::NEWLINE, "end of statement");
+  return stmt;
+}
+
+ast::Stmt *ScriptParser::parseExprStmt() {
+  int line = peek().line;
+  auto first = parseTestlist();
+
+  BinaryOp op;
+  bool augmented = true;
+  switch (peek().type) {
+    case TokenType::ADD_ASSIGN: op = BinaryOp::ADD; break;
+    case TokenType::SUB_ASSIGN: op = BinaryOp::SUB; break;
+    case TokenType::MULT_ASSIGN: op = BinaryOp::MUL; break;
+    case TokenType::DIV_ASSIGN: op = BinaryOp::DIV; break;
+    case TokenType::IDIV_ASSIGN: op = BinaryOp::IDIV; break;
+    case TokenType::MOD_ASSIGN: op = BinaryOp::MOD; break;
+    default: augmented = false; break;
+  }
+  if (augmented) {
+    pos++;
+    auto stmt = program->make<ast::AugAssignStmt>(line);
+    stmt->targets = targetsOf(first);
+    stmt->op = op;
+    stmt->values = parseTestlistInto();
+    return stmt;
+  }
+  if (!check(TokenType::ASSIGN)) {
+    auto stmt = program->make<ast::ExprStmt>(line);
+    stmt->values = program->list(std::move(first));
+    return stmt;
+  }
+  std::vector<std::vector<ast::Expr *>> testlists;
+  testlists.push_back(std::move(first));
+  while (accept(TokenType::ASSIGN)) {
+    testlists.push_back(parseTestlist());
+  }
+  auto stmt = program->make<ast::AssignStmt>(line);
+  // targets are assigned right to left, like EvalVisitor::visitExpr_stmt
+  std::vector<ast::List<std::string>> targets;
+  for (int i = (int)testlists.size() - 2; i >= 0; --i) {
+    targets.push_back(targetsOf(testlists[i]));
+  }
+  stmt->targets = program->list(std::move(targets));
+  stmt->values = program->list(std::move(testlists.back()));
+  return stmt;
+}
+
+ast::Stmt *ScriptParser::parseFlowStmt() {
+  int line = peek().line;
+  if (accept(TokenType::BREAK)) {
+    return program->make<ast::BreakStmt>(line);
+  }
+  if (accept(TokenType::CONTINUE)) {
+    return program->make<ast::ContinueStmt>(line);
+  }
+  expect(TokenType::RETURN, "return");
+  auto stmt = program->make<ast::ReturnStmt>(line);
+  if (startsTest()) {
+    stmt->values = parseTestlistInto();
+  }
+  return stmt;
+}
+
+ast::Stmt *ScriptParser::parseIf() {
+  auto stmt = program->make<ast::IfStmt>(peek().line);
+  expect(TokenType::IF, "if");
+  std::vector<ast::Expr *> conditions;
+  std::vector<ast::Suite> bodies;
+  do {
+    conditions.push_back(parseTest());
+    expect(TokenType::COLON, "':'");
+    bodies.push_back(parseSuite());
+  } while (accept(TokenType::ELIF));
+  stmt->conditions = program->list(std::move(conditions));
+  stmt->bodies = program->list(std::move(bodies));
+  if (accept(TokenType::ELSE)) {
+    expect(TokenType::COLON, "':'");
+    stmt->hasElse = true;
+    stmt->orelse = parseSuite();
+  }
+  return stmt;
+}
+
+ast::Stmt *ScriptParser::parseWhile() {
+  auto stmt = program->make<ast::WhileStmt>(peek().line);
+  expect(TokenType::WHILE, "while");
+  stmt->condition = parseTest();
+  expect(TokenType::COLON, "':'");
+  stmt->body = parseSuite();
+  return stmt;
+}
+
+ast::Stmt *ScriptParser::parseFuncDef() {
+  auto stmt = program->make<ast::FuncDef>(peek().line);
+  expect(TokenType::DEF, "def");
+  stmt->name = text(expect(TokenType::NAME, "function name"));
+  expect(TokenType::OPEN_PAREN, "'('");
+  std::vector<std::string> names;
+  std::vector<ast::Expr *> defaults;
+  if (!check(TokenType::CLOSE_PAREN)) {
+    do {
+      names.push_back(text(expect(TokenType::NAME, "parameter name")));
+      if (accept(TokenType::ASSIGN)) {
+        defaults.push_back(parseTest());
+      }
+    } while (accept(TokenType::COMMA));
+  }
+  expect(TokenType::CLOSE_PAREN, "')'");
+  expect(TokenType::COLON, "':'");
+  // defaults go to the last parameters, as in AstBuilder
+  size_t firstDefault = names.size() - defaults.size();
+  std::vector<ast::Parameter> parameters;
+  for (size_t i = 0; i < names.size(); ++i) {
+    ast::Parameter param;
+    param.name = names[i];
+    if (i >= firstDefault) {
+      param.defaultValue = defaults[i - firstDefault];
+    }
+    parameters.push_back(param);
+  }
+  stmt->parameters = program->list(std::move(parameters));
+  stmt->body = parseSuite();
+  return stmt;
+}
+
+ast::Suite ScriptParser::parseSuite() {
+  std::vector<ast::Stmt *> suite;
+  if (!accept(TokenType::NEWLINE)) {
+    suite.push_back(parseSimpleStmt());
+  } else {
+    expect(TokenType::INDENT, "indented block");
+    do {
+      parseStmt(suite);
+    } while (!accept(TokenType::DEDENT));
+  }
+  return program->list(std::move(suite));
+}
+
+std::vector<ast::Expr *> ScriptParser::parseTestlist() {
+  std::vector<ast::Expr *> values;
+  values.push_back(parseTest());
+  while (accept(TokenType::COMMA)) {
+    if (!startsTest()) break;
+    values.push_back(parseTest());
+  }
+  return values;
+}
+
+ast::List<ast::Expr *> ScriptParser::parseTestlistInto() {
+  return program->list(parseTestlist());
+}
+
+ast::List<std::string> ScriptParser::targetsOf(const std::vector<ast::Expr *> &exprs) const {
+  std::vector<std::string> names;
+  for (auto expr : exprs) {
+    if (expr->kind != ast::Expr::NAME) fail("a name to assign to");
+    names.push_back(static_cast<ast::NameExpr *>(expr)->name);
+  }
+  return program->list(std::move(names));
+}
+
+ast::Expr *ScriptParser::parseTest() {
+  int line = peek().line;
+  ast::Expr *first = parseAndTest();
+  if (!check(TokenType::OR)) return first;
+  auto expr = program->make<ast::BooleanExpr>(line);
+  expr->isAnd = false;
+  std::vector<ast::Expr *> operands{first};
+  while (accept(TokenType::OR)) {
+    operands.push_back(parseAndTest());
+  }
+  expr->operands = program->list(std::move(operands));
+  return expr;
+}
+
+ast::Expr *ScriptParser::parseAndTest() {
+  int line = peek().line;
+  ast::Expr *first = parseNotTest();
+  if (!check(TokenType::AND)) return first;
+  auto expr = program->make<ast::BooleanExpr>(line);
+  expr->isAnd = true;
+  std::vector<ast::Expr *> operands{first};
+  while (accept(TokenType::AND)) {
+    operands.push_back(parseNotTest());
+  }
+  expr->operands = program->list(std::move(operands));
+  return expr;
+}
+
+ast::Expr *ScriptParser::parseNotTest() {
+  if (check(TokenType::NOT)) {
+    auto expr = program->make<ast::UnaryExpr>(peek().line);
+    pos++;
+    expr->op = ast::UnaryExpr::NOT;
+    expr->operand = parseNotTest();
+    return expr;
+  }
+  return parseComparison();
+}
+
+static bool compareOp(TokenType type, BinaryOp &op) {
+  switch (type) {
+    case TokenType::LESS_THAN: op = BinaryOp::LT; return true;
+    case TokenType::GREATER_THAN: op = BinaryOp::GT; return true;
+    case TokenType::EQUALS: op = BinaryOp::EQ; return true;
+    case TokenType::GT_EQ: op = BinaryOp::GE; return true;
+    case TokenType::LT_EQ: op = BinaryOp::LE; return true;
+    case TokenType::NOT_EQ: op = BinaryOp::NE; return true;
+    default: return false;
+  }
+}
+
+ast::Expr *ScriptParser::parseComparison() {
+  int line = peek().line;
+  ast::Expr *first = parseArithExpr();
+  BinaryOp op;
+  if (!compareOp(peek().type, op)) return first;
+  auto expr = program->make<ast::CompareExpr>(line);
+  std::vector<ast::Expr *> operands{first};
+  std::vector<BinaryOp> ops;
+  while (compareOp(peek().type, op)) {
+    pos++;
+    ops.push_back(op);
+    operands.push_back(parseArithExpr());
+  }
+  expr->operands = program->list(std::move(operands));
+  expr->ops = program->list(std::move(ops));
+  return expr;
+}
+
+ast::Expr *ScriptParser::parseArithExpr() {
+  ast::Expr *result = parseTerm();
+  while (check(TokenType::ADD) || check(TokenType::MINUS)) {
+    auto expr = program->make<ast::BinaryExpr>(peek().line);
+    expr->op = check(TokenType::ADD) ? BinaryOp::ADD : BinaryOp::SUB;
+    pos++;
+    expr->left = result;
+    expr->right = parseTerm();
+    result = expr;
+  }
+  return result;
+}
+
+ast::Expr *ScriptParser::parseTerm() {
+  ast::Expr *result = parseFactor();
+  while (true) {
+    BinaryOp op;
+    switch (peek().type) {
+      case TokenType::STAR: op = BinaryOp::MUL; break;
+      case TokenType::DIV: op = BinaryOp::DIV; break;
+      case TokenType::IDIV: op = BinaryOp::IDIV; break;
+      case TokenType::MOD: op = BinaryOp::MOD; break;
+      default: return result;
+    }
+    auto expr = program->make<ast::BinaryExpr>(peek().line);
+    pos++;
+    expr->op = op;
+    expr->left = result;
+    expr->right = parseFactor();
+    result = expr;
+  }
+}
+
+ast::Expr *ScriptParser::parseFactor() {
+  if (check(TokenType::ADD) || check(TokenType::MINUS)) {
+    auto expr = program->make<ast::UnaryExpr>(peek().line);
+    expr->op = check(TokenType::ADD) ? ast::UnaryExpr::PLUS : ast::UnaryExpr::MINUS;
+    pos++;
+    expr->operand = parseFactor();
+    return expr;
+  }
+  return parseAtomExpr();
+}
+
+ast::Expr *ScriptParser::parseAtomExpr() {
+  if (!check(TokenType::NAME) || tokens[pos + 1].type != TokenType::OPEN_PAREN) {
+    ast::Expr *atom = parseAtom();
+    if (check(TokenType::OPEN_PAREN)) fail("a function name before '('");
+    return atom;
+  }
+  auto call = program->make<ast::CallExpr>(peek().line);
+  call->name = text(peek());
+  pos += 2;
+  std::vector<ast::Expr *> args;
+  std::vector<std::string> keywords;
+  while (!check(TokenType::CLOSE_PAREN)) {
+    ast::Expr *value = parseTest();
+    if (accept(TokenType::ASSIGN)) {
+      if (value->kind != ast::Expr::NAME) fail("a keyword name");
+      keywords.push_back(static_cast<ast::NameExpr *>(value)->name);
+      value = parseTest();
+    } else {
+      keywords.emplace_back();
+    }
+    args.push_back(value);
+    if (!accept(TokenType::COMMA)) break;
+  }
+  expect(TokenType::CLOSE_PAREN, "')'");
+  call->args = program->list(std::move(args));
+  call->keywords = program->list(std::move(keywords));
+  return call;
+}
+
+ast::Expr *ScriptParser::parseAtom() {
+  const Token &token = peek();
+  switch (token.type) {
+    case TokenType::NAME: {
+      auto expr = program->make<ast::NameExpr>(token.line);
+      expr->name = text(token);
+      pos++;
+      return expr;
+    }
+    case TokenType::OPEN_PAREN: {
+      pos++;
+      ast::Expr *inner = parseTest();
+      expect(TokenType::CLOSE_PAREN, "')'");
+      return inner;
+    }
+    case TokenType::FORMAT_START:
+      return parseFormatString();
+    default:
+      break;
+  }
+  auto expr = program->make<ast::ConstantExpr>(token.line);
+  switch (token.type) {
+    case TokenType::NUMBER:
+      expr->value = ast::numberValue(text(token));
+      pos++;
+      break;
+    case TokenType::STRING: {
+      std::string str;
+      while (check(TokenType::STRING)) {
+        ast::appendStringValue(str, text(peek()));
+        pos++;
+      }
+      expr->value = Value(std::move(str));
+      break;
+    }
+    case TokenType::TRUE:
+      expr->value = Value(true);
+      pos++;
+      break;
+    case TokenType::FALSE:
+      expr->value = Value(false);
+      pos++;
+      break;
+    case TokenType::NONE:
+      expr->value = Value(None{});
+      pos++;
+      break;
+    default:
+      fail("an expression");
+  }
+  return expr;
+}
+
+ast::Expr *ScriptParser::parseFormatString() {
+  auto expr = program->make<ast::FStringExpr>(peek().line);
+  expect(TokenType::FORMAT_START, "f\"");
+  std::vector<std::string> literals(1);
+  std::vector<ast::List<ast::Expr *>> slots;
+  while (!accept(TokenType::FORMAT_END)) {
+    if (check(TokenType::FORMAT_LITERAL)) {
+      ast::appendFormatLiteral(literals.back(), text(peek()));
+      pos++;
+    } else {
+      expect(TokenType::OPEN_BRACE, "'{' or the end of the f-string");
+      slots.push_back(parseTestlistInto());
+      literals.emplace_back();
+      expect(TokenType::CLOSE_BRACE, "'}'");
+    }
+  }
+  expr->literals = program->list(std::move(literals));
+  expr->slots = program->list(std::move(slots));
+  return expr;
+}
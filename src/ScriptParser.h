@@ -0,0 +1,62 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_SCRIPTPARSER_H
+#define PYTHON_INTERPRETER_SCRIPTPARSER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Ast.h"
+#include "Tokenizer.h"
+
+// Recursive-descent parser for Python3Parser.g4 that builds the AST
+// directly, without ANTLR's parse tree. It accepts exactly the inputs the
+// ANTLR front end parses without errors and produces the same tree as
+// AstBuilder for them. Anything else throws runtime_error; the caller
+// then re-parses with ANTLR, which reports and recovers from the error.
+class ScriptParser {
+public:
+  ScriptParser(const char *data, size_t size);
+
+  std::unique_ptr<ast::Program> parse();
+
+private:
+  const char *source;
+  size_t size;
+  std::vector<Token> tokens;
+  size_t pos = 0;
+  ast::Program *program = nullptr;
+
+  const Token &peek() const { return tokens[pos]; }
+  bool check(TokenType type) const { return tokens[pos].type == type; }
+  bool accept(TokenType type);
+  const Token &expect(TokenType type, const char *what);
+  std::string text(const Token &token) const;
+  [[noreturn]] void fail(const char *what) const;
+  // Whether the next token can start a test.
+  bool startsTest() const;
+
+  void parseStmt(std::vector<ast::Stmt *> &out);
+  ast::Stmt *parseSimpleStmt();
+  ast::Stmt *parseExprStmt();
+  ast::Stmt *parseFlowStmt();
+  ast::Stmt *parseIf();
+  ast::Stmt *parseWhile();
+  ast::Stmt *parseFuncDef();
+  ast::Suite parseSuite();
+
+  std::vector<ast::Expr *> parseTestlist();
+  ast::List<ast::Expr *> parseTestlistInto();
+  ast::List<std::string> targetsOf(const std::vector<ast::Expr *> &exprs) const;
+  ast::Expr *parseTest();
+  ast::Expr *parseAndTest();
+  ast::Expr *parseNotTest();
+  ast::Expr *parseComparison();
+  ast::Expr *parseArithExpr();
+  ast::Expr *parseTerm();
+  ast::Expr *parseFactor();
+  ast::Expr *parseAtomExpr();
+  ast::Expr *parseAtom();
+  ast::Expr *parseFormatString();
+};
+
+#endif//PYTHON_INTERPRETER_SCRIPTPARSER_H
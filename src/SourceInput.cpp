@@ -0,0 +1,127 @@
+#include "SourceInput.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::unique_ptr<SourceFile> SourceFile::open(const std::string &path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("cannot open " + path + ": " + strerror(errno));
+  }
+  std::unique_ptr<SourceFile> source;
+  try {
+    source = fromDescriptor(fd, path);
+  } catch (...) {
+    ::close(fd);
+    throw;
+  }
+  ::close(fd);
+  return source;
+}
+
+std::unique_ptr<SourceFile> SourceFile::fromDescriptor(int fd, const std::string &name) {
+  std::unique_ptr<SourceFile> source(new SourceFile());
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED) {
+      madvise(addr, st.st_size, MADV_SEQUENTIAL);
+      source->begin = static_cast<const char *>(addr);
+      source->length = st.st_size;
+      source->mapped = true;
+      return source;
+    }
+  }
+  // pipes, terminals and empty files
+  char buf[1 << 16];
+  while (true) {
+    ssize_t got = ::read(fd, buf, sizeof(buf));
+    if (got < 0) {
+      if (errno == EINTR) continue;
+      // running the part that was read would run a truncated program
+      throw std::runtime_error("cannot read " + name + ": " + strerror(errno));
+    }
+    if (got == 0) break;
+    source->owned.append(buf, got);
+  }
+  source->begin = source->owned.data();
+  source->length = source->owned.size();
+  return source;
+}
+
+SourceFile::~SourceFile() {
+  if (mapped) {
+    munmap(const_cast<char *>(begin), length);
+  }
+}
+
+bool SourceFile::isAscii() const {
+  for (size_t i = 0; i < length; ++i) {
+    if (static_cast<unsigned char>(begin[i]) >= 0x80) return false;
+  }
+  return true;
+}
+
+std::unique_ptr<antlr4::CharStream> SourceFile::makeCharStream() const {
+  if (isAscii()) {
+    return std::make_unique<ByteCharStream>(begin, length);
+  }
+  return std::make_unique<antlr4::ANTLRInputStream>(begin, length);
+}
+
+ByteCharStream::ByteCharStream(const char *data, size_t size, std::string name)
+    : data(data), length(size), name(std::move(name)) {}
+
+void ByteCharStream::consume() {
+  if (p >= length) {
+    throw antlr4::IllegalStateException("cannot consume EOF");
+  }
+  p++;
+}
+
+size_t ByteCharStream::LA(ssize_t i) {
+  if (i == 0) return 0;
+  ssize_t position = (ssize_t)p + (i < 0 ? i : i - 1);
+  if (position < 0 || position >= (ssize_t)length) {
+    return antlr4::IntStream::EOF;
+  }
+  return static_cast<unsigned char>(data[position]);
+}
+
+ssize_t ByteCharStream::mark() {
+  return -1;
+}
+
+void ByteCharStream::release(ssize_t) {}
+
+size_t ByteCharStream::index() {
+  return p;
+}
+
+void ByteCharStream::seek(size_t index) {
+  p = std::min(index, length);
+}
+
+size_t ByteCharStream::size() {
+  return length;
+}
+
+std::string ByteCharStream::getSourceName() const {
+  return name;
+}
+
+std::string ByteCharStream::getText(const antlr4::misc::Interval &interval) {
+  if (interval.a < 0 || interval.b < 0) return "";
+  size_t start = interval.a;
+  size_t stop = std::min<size_t>(interval.b, length - 1);
+  if (start >= length || stop < start) return "";
+  return std::string(data + start, stop - start + 1);
+}
+
+std::string ByteCharStream::toString() const {
+  return std::string(data, length);
+}
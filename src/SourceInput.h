@@ -0,0 +1,66 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_SOURCEINPUT_H
+#define PYTHON_INTERPRETER_SOURCEINPUT_H
+
+#include <memory>
+#include <string>
+#include "antlr4-runtime.h"
+
+// The program text. A regular file (a path argument, or stdin redirected
+// from a file) is mmap'd read-only; anything else, like a pipe, is read
+// with read(2) into an owned buffer. Either way no iostream is involved.
+class SourceFile {
+public:
+  // Map the file at path. Throws runtime_error if it cannot be opened.
+  static std::unique_ptr<SourceFile> open(const std::string &path);
+  // Map or read the given file descriptor (stdin by default). Throws
+  // runtime_error, naming the input as name, if reading fails.
+  static std::unique_ptr<SourceFile> fromDescriptor(int fd = 0, const std::string &name = "<stdin>");
+
+  ~SourceFile();
+  SourceFile(const SourceFile &) = delete;
+  SourceFile &operator=(const SourceFile &) = delete;
+
+  const char *data() const { return begin; }
+  size_t size() const { return length; }
+
+  // True if every byte is 7-bit ASCII, i.e. bytes and code points coincide.
+  bool isAscii() const;
+
+  // A CharStream for the lexer. ASCII sources are lexed in place; anything
+  // else falls back to ANTLRInputStream, which decodes UTF-8 into UTF-32.
+  std::unique_ptr<antlr4::CharStream> makeCharStream() const;
+
+private:
+  SourceFile() = default;
+  const char *begin = nullptr;
+  size_t length = 0;
+  bool mapped = false;
+  std::string owned;
+};
+
+// A zero-copy CharStream over a byte buffer, for sources whose code points
+// are all single bytes. The buffer must outlive the stream.
+class ByteCharStream : public antlr4::CharStream {
+public:
+  ByteCharStream(const char *data, size_t size, std::string name = "<stdin>");
+
+  void consume() override;
+  size_t LA(ssize_t i) override;
+  ssize_t mark() override;
+  void release(ssize_t marker) override;
+  size_t index() override;
+  void seek(size_t index) override;
+  size_t size() override;
+  std::string getSourceName() const override;
+  std::string getText(const antlr4::misc::Interval &interval) override;
+  std::string toString() const override;
+
+private:
+  const char *data;
+  size_t length;
+  size_t p = 0;
+  std::string name;
+};
+
+#endif//PYTHON_INTERPRETER_SOURCEINPUT_H
@@ -0,0 +1,70 @@
+#include "Stats.h"
+#include "Memory.h"
+#include "Output.h"
+#include "Pool.h"
+#include <algorithm>
+#include <vector>
+
+static const char *typeName(int type) {
+  static const char *names[RuntimeStats::TYPE_COUNT] = {"unbound", "None", "bool", "int", "float", "str", "tuple", "undefined"};
+  return names[type];
+}
+
+void RuntimeStats::enable() {
+  enabled = true;
+  sjtu::int2048::count_allocations = true;
+}
+
+void RuntimeStats::writeJson(std::ostream &out) const {
+  struct Row {
+    int op, left, right;
+    uint64_t count;
+  };
+  std::vector<Row> rows;
+  for (int op = 0; op < OP_COUNT; ++op) {
+    for (int left = 0; left < TYPE_COUNT; ++left) {
+      for (int right = 0; right < TYPE_COUNT; ++right) {
+        if (binaryOps[op][left][right]) rows.push_back(Row{op, left, right, binaryOps[op][left][right]});
+      }
+    }
+  }
+  std::stable_sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) { return a.count > b.count; });
+
+  out << "{\n  \"binary_ops\": [";
+  for (size_t i = 0; i < rows.size(); ++i) {
+    out << (i ? ",\n    " : "\n    ") << "{\"op\": \"" << binaryOpName(static_cast<BinaryOp>(rows[i].op))
+        << "\", \"left\": \"" << typeName(rows[i].left) << "\", \"right\": \"" << typeName(rows[i].right)
+        << "\", \"count\": " << rows[i].count << "}";
+  }
+  out << (rows.empty() ? "],\n" : "\n  ],\n");
+  out << "  \"variable_reads\": {\"local\": " << localReads << ", \"global\": " << globalReads << "},\n";
+  out << "  \"calls\": {\"count\": " << calls << ", \"max_depth\": " << maxDepth << "},\n";
+
+  // buckets past the largest one used are left out
+  int used = sjtu::int2048::LIMB_BUCKETS;
+  while (used > 0 && !sjtu::int2048::limb_histogram[used - 1]) used--;
+  out << "  \"int2048\": {\"allocations\": " << sjtu::int2048::allocations << ", \"limb_histogram\": [";
+  for (int i = 0; i < used; ++i) {
+    out << (i ? ", " : "") << "{\"max_limbs\": ";
+    if (i + 1 < sjtu::int2048::LIMB_BUCKETS) {
+      out << (1ull << i);
+    } else {
+      out << "null";
+    }
+    out << ", \"count\": " << sjtu::int2048::limb_histogram[i] << "}";
+  }
+  out << "]},\n";
+  out << "  \"pools\": {\"values\": ";
+  valuePool().writeJson(out);
+  out << ",\n    \"limbs\": {\"requests\": " << sjtu::limb_pool::requests << ", \"reused\": " << sjtu::limb_pool::reused
+      << "},\n    \"frame_slots\": {\"peak\": " << maxFrameSlots << "}},\n";
+  out << "  \"memory\": ";
+  memoryBudget().writeJson(out);
+  out << ",\n";
+  out << "  \"print_bytes\": " << output().bytesWritten() << "\n}\n";
+}
+
+RuntimeStats &stats() {
+  static RuntimeStats counters;
+  return counters;
+}
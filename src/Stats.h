@@ -0,0 +1,51 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_STATS_H
+#define PYTHON_INTERPRETER_STATS_H
+
+#include <cstdint>
+#include <ostream>
+#include "Value.h"
+
+// Counters of what the engines spend their time on, to tell which
+// optimizations matter for a workload. They are always compiled in; every
+// counting site first tests enabled, so they cost a predictable branch
+// while switched off.
+struct RuntimeStats {
+  static const int OP_COUNT = (int)BinaryOp::NE + 1;
+  static const int TYPE_COUNT = (int)Value::UNDEFINED + 1;
+
+  bool enabled = false;
+  // binary operations by operator, left type and right type
+  uint64_t binaryOps[OP_COUNT][TYPE_COUNT][TYPE_COUNT] = {};
+  // variable reads resolved in the local and in the global scope
+  uint64_t localReads = 0;
+  uint64_t globalReads = 0;
+  // user function calls and the deepest nesting of them
+  uint64_t calls = 0;
+  uint64_t maxDepth = 0;
+  // the most VM frame slots (locals of all frames) in use at once
+  uint64_t maxFrameSlots = 0;
+
+  // Start counting, including int2048 allocations.
+  void enable();
+
+  void countBinary(BinaryOp op, Value::Type left, Value::Type right) {
+    ++binaryOps[(int)op][left][right];
+  }
+  void countCall(uint64_t depth) {
+    ++calls;
+    if (depth > maxDepth) maxDepth = depth;
+  }
+  void countFrameSlots(uint64_t slots) {
+    if (slots > maxFrameSlots) maxFrameSlots = slots;
+  }
+
+  // All counters as one JSON object, together with the int2048 allocation
+  // statistics, the allocation pools and the number of bytes print() wrote.
+  void writeJson(std::ostream &out) const;
+};
+
+// The process-wide counters.
+RuntimeStats &stats();
+
+#endif//PYTHON_INTERPRETER_STATS_H
@@ -0,0 +1,105 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool &ThreadPool::shared() {
+  static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+  return pool;
+}
+
+ThreadPool::ThreadPool(size_t threads) : count(std::max<size_t>(1, threads)) {}
+
+ThreadPool::~ThreadPool() {
+  stop();
+}
+
+void ThreadPool::setThreads(size_t threads) {
+  stop();
+  count = std::max<size_t>(1, threads);
+}
+
+void ThreadPool::start() {
+  stopping = false;
+  for (size_t i = 1; i < count; ++i) {
+    workers.emplace_back(&ThreadPool::work, this);
+  }
+}
+
+void ThreadPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto &worker : workers) worker.join();
+  workers.clear();
+}
+
+void ThreadPool::runChunks(Loop &loop) {
+  for (;;) {
+    size_t chunk = loop.next.fetch_add(1);
+    if (chunk >= loop.chunks) return;
+    size_t begin = chunk * loop.chunk;
+    if (!loop.failed.load()) {
+      try {
+        (*loop.body)(begin, std::min(loop.size, begin + loop.chunk));
+      } catch (...) {
+        if (!loop.failed.exchange(true)) loop.error = std::current_exception();
+      }
+    }
+    loop.done.fetch_add(1);
+  }
+}
+
+void ThreadPool::work() {
+  unsigned long long seen = 0;
+  for (;;) {
+    Loop *loop;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [&] { return stopping || (current && generation != seen); });
+      if (stopping) return;
+      seen = generation;
+      loop = current;
+      loop->users++;
+    }
+    runChunks(*loop);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      loop->users--;
+    }
+    finished.notify_all();
+  }
+}
+
+void ThreadPool::parallelFor(size_t size, size_t grain, const std::function<void(size_t, size_t)> &body) {
+  if (size == 0) return;
+  grain = std::max<size_t>(1, grain);
+  // a few chunks per thread, so a thread that is slow to start is not waited for
+  size_t chunks = std::min((size + grain - 1) / grain, count * 4);
+  bool expected = false;
+  if (count == 1 || chunks <= 1 || !busy.compare_exchange_strong(expected, true)) {
+    body(0, size);
+    return;
+  }
+  if (workers.empty()) start();
+
+  Loop loop;
+  loop.body = &body;
+  loop.size = size;
+  loop.chunk = (size + chunks - 1) / chunks;
+  loop.chunks = (size + loop.chunk - 1) / loop.chunk;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    current = &loop;
+    generation++;
+  }
+  wake.notify_all();
+  runChunks(loop);
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return loop.done.load() == loop.chunks && loop.users == 0; });
+    current = nullptr;
+  }
+  busy.store(false);
+  if (loop.error) std::rethrow_exception(loop.error);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_THREADPOOL_H
+#define PYTHON_INTERPRETER_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads for data-parallel loops inside single operations, such as
+// the transforms of a large int2048 multiply. The calling thread takes part
+// in every loop, so a pool of n threads starts n - 1 workers, and it starts
+// them only when the first loop needs them. One loop runs at a time; a
+// loop started from inside another runs serially on its caller.
+class ThreadPool {
+public:
+  // The process-wide pool, sized to the hardware until setThreads.
+  static ThreadPool &shared();
+
+  explicit ThreadPool(size_t threads);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Threads a loop is spread over, the caller included; at least 1.
+  void setThreads(size_t threads);
+  size_t threads() const { return count; }
+
+  // Call body(begin, end) on consecutive ranges covering [0, size), each
+  // at least grain long, and return once all of them are done. If a range
+  // throws, the ranges not yet started are skipped and the first exception
+  // is rethrown here.
+  void parallelFor(size_t size, size_t grain, const std::function<void(size_t, size_t)> &body);
+
+private:
+  struct Loop {
+    const std::function<void(size_t, size_t)> *body;
+    size_t size;
+    size_t chunk;
+    size_t chunks;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    // workers that may still touch the loop
+    size_t users = 0;
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+  };
+
+  size_t count;
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable finished;
+  Loop *current = nullptr;
+  unsigned long long generation = 0;
+  bool stopping = false;
+  std::atomic<bool> busy{false};
+
+  void start();
+  void stop();
+  void work();
+  static void runChunks(Loop &loop);
+};
+
+#endif//PYTHON_INTERPRETER_THREADPOOL_H
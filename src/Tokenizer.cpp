@@ -0,0 +1,393 @@
+#include "Tokenizer.h"
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+static bool isDigit(int c) {
+  return c >= '0' && c <= '9';
+}
+
+static bool isNameStart(int c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool isNameChar(int c) {
+  return isNameStart(c) || isDigit(c);
+}
+
+// The prefixes STRING_LITERAL and BYTES_LITERAL accept before a quote.
+static bool isStringPrefix(const char *word, size_t length) {
+  static const char *const prefixes[] = {"r", "u", "b", "fr", "rf", "br", "rb"};
+  if (length == 0 || length > 2) return false;
+  for (auto prefix : prefixes) {
+    if (strlen(prefix) != length) continue;
+    bool match = true;
+    for (size_t i = 0; i < length; ++i) {
+      if ((word[i] | 0x20) != prefix[i]) match = false;
+    }
+    if (match) return true;
+  }
+  return false;
+}
+
+struct Keyword {
+  const char *text;
+  TokenType type;
+};
+
+static const Keyword keywords[] = {
+    {"def", TokenType::DEF},     {"return", TokenType::RETURN},     {"if", TokenType::IF},
+    {"elif", TokenType::ELIF},   {"else", TokenType::ELSE},         {"while", TokenType::WHILE},
+    {"not", TokenType::NOT},     {"and", TokenType::AND},           {"or", TokenType::OR},
+    {"None", TokenType::NONE},   {"True", TokenType::TRUE},         {"False", TokenType::FALSE},
+    {"break", TokenType::BREAK}, {"continue", TokenType::CONTINUE},
+};
+
+Tokenizer::Tokenizer(const char *data, size_t size) : data(data), size(size) {}
+
+void Tokenizer::push(TokenType type, size_t start, int startLine) {
+  tokens.push_back(Token{type, startLine, (uint32_t)start, (uint32_t)(pos - start)});
+}
+
+void Tokenizer::fail(const char *what) const {
+  throw std::runtime_error(std::string("SyntaxError: ") + what + " (line " + std::to_string(line) + ")");
+}
+
+std::vector<Token> Tokenizer::tokenize() {
+  if (size > UINT32_MAX) fail("source too large");
+  // leading blanks on the very first line are a NEWLINE token in the
+  // grammar, which is only harmless if the line is blank
+  if (peekChar() == ' ' || peekChar() == '\t') {
+    while (peekChar() == ' ' || peekChar() == '\t') pos++;
+    int next = peekChar();
+    if (next != '\r' && next != '\n' && next != '#') fail("unexpected indent");
+  }
+  while (true) {
+    if (formatMode > 0 && !exprMode) {
+      lexFormatLiteral();
+      continue;
+    }
+    int c = peekChar();
+    if (c < 0) break;
+    if (c == '\n' || c == '\r') {
+      lexNewline();
+    } else if (c == ' ' || c == '\t') {
+      pos++;
+    } else if (c == '#') {
+      while (pos < size && data[pos] != '\r' && data[pos] != '\n' && data[pos] != '\f') pos++;
+    } else if (c == '\\') {
+      // explicit line joining: backslash, optional blanks, line break
+      size_t p = pos + 1;
+      while (p < size && (data[p] == ' ' || data[p] == '\t')) p++;
+      if (p < size && data[p] == '\r') {
+        p++;
+        if (p < size && data[p] == '\n') {
+          p++;
+          line++;
+        }
+      } else if (p < size && data[p] == '\n') {
+        p++;
+        line++;
+      } else {
+        fail("unexpected character after line continuation");
+      }
+      pos = p;
+    } else if (isDigit(c) || (c == '.' && isDigit(peekChar(1)))) {
+      lexNumber();
+    } else if (c == 'f' && peekChar(1) == '"') {
+      size_t start = pos;
+      pos += 2;
+      push(TokenType::FORMAT_START, start, line);
+      formatMode++;
+      exprMode = false;
+    } else if (isNameStart(c)) {
+      lexName();
+    } else if (c == '"' || c == '\'') {
+      lexString();
+    } else {
+      lexOperator();
+    }
+  }
+  if (formatMode > 0) fail("unterminated f-string");
+  // like Python3Lexer::nextToken: close open blocks at the end of input
+  if (!indents.empty()) {
+    push(TokenType::NEWLINE, pos, line);
+    while (!indents.empty()) {
+      push(TokenType::DEDENT, pos, line);
+      indents.pop_back();
+    }
+  }
+  push(TokenType::END, pos, line);
+  return std::move(tokens);
+}
+
+void Tokenizer::lexNewline() {
+  size_t start = pos;
+  int startLine = line;
+  if (data[pos] == '\r') pos++;
+  if (pos < size && data[pos] == '\n') {
+    pos++;
+    line++;
+  }
+  size_t newlineEnd = pos;
+  int indent = 0;
+  while (pos < size && (data[pos] == ' ' || data[pos] == '\t')) {
+    if (data[pos] == '\t') {
+      indent += 8 - indent % 8;
+    } else {
+      indent++;
+    }
+    pos++;
+  }
+  int next = peekChar();
+  if (next == '\f') fail("form feed");
+  if (opened > 0 || next == '\r' || next == '\n' || next == '#') return;
+
+  tokens.push_back(Token{TokenType::NEWLINE, startLine, (uint32_t)start, (uint32_t)(newlineEnd - start)});
+  int previous = indents.empty() ? 0 : indents.back();
+  if (indent > previous) {
+    indents.push_back(indent);
+    tokens.push_back(Token{TokenType::INDENT, line, (uint32_t)newlineEnd, (uint32_t)(pos - newlineEnd)});
+  } else {
+    while (!indents.empty() && indents.back() > indent) {
+      tokens.push_back(Token{TokenType::DEDENT, line, (uint32_t)pos, 0});
+      indents.pop_back();
+    }
+  }
+}
+
+void Tokenizer::lexFormatLiteral() {
+  if (pos >= size) fail("unterminated f-string");
+  size_t start = pos;
+  size_t p = pos;
+  while (p < size) {
+    char c = data[p];
+    if (c == '\\') {
+      if (p + 1 >= size || data[p + 1] == '\r' || data[p + 1] == '\n' || data[p + 1] == '\f') break;
+      p += 2;
+    } else if (c == '{' || c == '}') {
+      if (p + 1 < size && data[p + 1] == c) {
+        p += 2;
+      } else {
+        break;
+      }
+    } else if (c == '"' || c == '\r' || c == '\n' || c == '\f') {
+      break;
+    } else {
+      p++;
+    }
+  }
+
+  if (p > start) {
+    // FORMAT_STRING_LITERAL comes after NUMBER, NAME and the keywords in
+    // the grammar, so they win ties and take the text when they are at
+    // least as long; a comment would swallow the rest of the line
+    size_t length = p - start;
+    int c = (unsigned char)data[start];
+    if (c == '#') fail("comment inside an f-string");
+    if (isDigit(c) || (c == '.' && start + 1 < size && isDigit(data[start + 1]))) {
+      bool supported;
+      if (scanNumber(start, supported) >= length) fail("number token inside an f-string");
+    }
+    if (isNameStart(c) || c >= 0x80) {
+      size_t q = start;
+      while (q < size && (isNameChar(data[q]) || (unsigned char)data[q] >= 0x80)) q++;
+      if (q - start >= length) fail("name token inside an f-string");
+      if (q < size && data[q] == '\'' && isStringPrefix(data + start, q - start)) fail("bytes token inside an f-string");
+    }
+    pos = p;
+    push(TokenType::FORMAT_LITERAL, start, line);
+    return;
+  }
+
+  if (data[pos] == '"') {
+    pos++;
+    push(TokenType::FORMAT_END, start, line);
+    formatMode--;
+    if (formatMode > 0) exprMode = true;
+  } else if (data[pos] == '{') {
+    pos++;
+    push(TokenType::OPEN_BRACE, start, line);
+    opened++;
+    exprMode = true;
+  } else {
+    fail("unexpected character in f-string");
+  }
+}
+
+size_t Tokenizer::scanNumber(size_t from, bool &supported) const {
+  supported = true;
+  auto at = [this](size_t i) -> int { return i < size ? (unsigned char)data[i] : -1; };
+  int radix = at(from + 1) | 0x20;
+  if (at(from) == '0' && (radix == 'x' || radix == 'o' || radix == 'b')) {
+    int digit = at(from + 2);
+    bool valid = radix == 'x' ? (isDigit(digit) || ((digit | 0x20) >= 'a' && (digit | 0x20) <= 'f'))
+                 : radix == 'o' ? (digit >= '0' && digit <= '7')
+                                : (digit == '0' || digit == '1');
+    if (valid) {
+      supported = false;
+      return 3;
+    }
+  }
+  size_t p = from;
+  while (isDigit(at(p))) p++;
+  size_t intDigits = p - from;
+  bool isFloat = false;
+  if (at(p) == '.') {
+    size_t q = p + 1;
+    while (isDigit(at(q))) q++;
+    if (intDigits > 0 || q > p + 1) {
+      p = q;
+      isFloat = true;
+    }
+  }
+  if ((intDigits > 0 || isFloat) && (at(p) | 0x20) == 'e') {
+    size_t q = p + 1;
+    if (at(q) == '+' || at(q) == '-') q++;
+    if (isDigit(at(q))) {
+      while (isDigit(at(q))) q++;
+      p = q;
+      isFloat = true;
+    }
+  }
+  if ((intDigits > 0 || isFloat) && (at(p) | 0x20) == 'j') {
+    supported = false;
+    return p + 1 - from;
+  }
+  if (isFloat) return p - from;
+  if (intDigits == 0) return 0;
+  if (data[from] == '0') {
+    // DECIMAL_INTEGER is NON_ZERO_DIGIT DIGIT* | '0'+, so 012 is two tokens
+    p = from;
+    while (at(p) == '0') p++;
+  }
+  return p - from;
+}
+
+void Tokenizer::lexNumber() {
+  bool supported;
+  size_t length = scanNumber(pos, supported);
+  if (!supported) fail("unsupported number literal");
+  size_t start = pos;
+  pos += length;
+  push(TokenType::NUMBER, start, line);
+}
+
+void Tokenizer::lexName() {
+  size_t start = pos;
+  while (pos < size && isNameChar(data[pos])) pos++;
+  if (peekChar() >= 0x80) fail("non-ASCII name");
+  size_t length = pos - start;
+  if ((peekChar() == '"' || peekChar() == '\'') && isStringPrefix(data + start, length)) {
+    fail("prefixed string literal");
+  }
+  for (auto &keyword : keywords) {
+    if (strlen(keyword.text) == length && memcmp(keyword.text, data + start, length) == 0) {
+      push(keyword.type, start, line);
+      return;
+    }
+  }
+  if ((length == 3 && memcmp(data + start, "for", 3) == 0) || (length == 2 && memcmp(data + start, "in", 2) == 0)) {
+    fail("unsupported keyword");
+  }
+  push(TokenType::NAME, start, line);
+}
+
+void Tokenizer::lexString() {
+  size_t start = pos;
+  int startLine = line;
+  char quote = data[pos];
+  if (peekChar(1) == quote && peekChar(2) == quote) {
+    // LONG_STRING: everything up to the first unescaped closing triple quote
+    pos += 3;
+    while (true) {
+      if (pos >= size) fail("unterminated string");
+      char c = data[pos];
+      if (c == '\\') {
+        if (pos + 1 >= size) fail("unterminated string");
+        if (data[pos + 1] == '\n') line++;
+        pos += 2;
+      } else if (c == quote && peekChar(1) == quote && peekChar(2) == quote) {
+        pos += 3;
+        break;
+      } else {
+        if (c == '\n') line++;
+        pos++;
+      }
+    }
+    push(TokenType::STRING, start, startLine);
+    return;
+  }
+  pos++;
+  while (true) {
+    if (pos >= size) fail("unterminated string");
+    char c = data[pos];
+    if (c == '\\') {
+      if (pos + 1 >= size) fail("unterminated string");
+      if (data[pos + 1] == '\n') line++;
+      pos += 2;
+    } else if (c == quote) {
+      pos++;
+      break;
+    } else if (c == '\r' || c == '\n' || c == '\f') {
+      fail("unterminated string");
+    } else {
+      pos++;
+    }
+  }
+  push(TokenType::STRING, start, startLine);
+}
+
+void Tokenizer::lexOperator() {
+  size_t start = pos;
+  int c = peekChar(), c1 = peekChar(1), c2 = peekChar(2);
+  // multi-character tokens of the ANTLR lexer that the grammar never uses
+  // must not be split into tokens it does use
+  if ((c == '*' && c1 == '*') || (c == '<' && c1 == '<') || (c == '>' && c1 == '>') || (c == '<' && c1 == '>') ||
+      (c == '-' && c1 == '>') || (c == '.' && c1 == '.' && c2 == '.')) {
+    fail("unsupported operator");
+  }
+  if (c == '/' && c1 == '/') {
+    pos += c2 == '=' ? 3 : 2;
+    push(c2 == '=' ? TokenType::IDIV_ASSIGN : TokenType::IDIV, start, line);
+    return;
+  }
+  if (c1 == '=') {
+    TokenType type;
+    switch (c) {
+      case '=': type = TokenType::EQUALS; break;
+      case '>': type = TokenType::GT_EQ; break;
+      case '<': type = TokenType::LT_EQ; break;
+      case '!': type = TokenType::NOT_EQ; break;
+      case '+': type = TokenType::ADD_ASSIGN; break;
+      case '-': type = TokenType::SUB_ASSIGN; break;
+      case '*': type = TokenType::MULT_ASSIGN; break;
+      case '/': type = TokenType::DIV_ASSIGN; break;
+      case '%': type = TokenType::MOD_ASSIGN; break;
+      default: fail("unsupported operator");
+    }
+    pos += 2;
+    push(type, start, line);
+    return;
+  }
+  TokenType type;
+  switch (c) {
+    case '(': type = TokenType::OPEN_PAREN; opened++; break;
+    case ')': type = TokenType::CLOSE_PAREN; opened--; break;
+    case '{': type = TokenType::OPEN_BRACE; opened++; exprMode = true; break;
+    case '}': type = TokenType::CLOSE_BRACE; opened--; exprMode = false; break;
+    case ',': type = TokenType::COMMA; break;
+    case ':': type = TokenType::COLON; break;
+    case '=': type = TokenType::ASSIGN; break;
+    case '+': type = TokenType::ADD; break;
+    case '-': type = TokenType::MINUS; break;
+    case '*': type = TokenType::STAR; break;
+    case '/': type = TokenType::DIV; break;
+    case '%': type = TokenType::MOD; break;
+    case '<': type = TokenType::LESS_THAN; break;
+    case '>': type = TokenType::GREATER_THAN; break;
+    default: fail("unexpected character");
+  }
+  pos++;
+  push(type, start, line);
+}
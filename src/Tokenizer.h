@@ -0,0 +1,113 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_TOKENIZER_H
+#define PYTHON_INTERPRETER_TOKENIZER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Tokens of the hand-written front end. Only the tokens the grammar can
+// actually use are represented; anything else the ANTLR lexer knows about
+// (for, [, **, hex numbers, prefixed strings, ...) is rejected up front.
+enum class TokenType : uint8_t {
+  END,
+  NEWLINE,
+  INDENT,
+  DEDENT,
+  NAME,
+  NUMBER,
+  STRING,
+  FORMAT_START,   // f"
+  FORMAT_LITERAL, // literal text inside an f-string
+  FORMAT_END,     // the " closing an f-string
+  DEF,
+  RETURN,
+  IF,
+  ELIF,
+  ELSE,
+  WHILE,
+  NOT,
+  AND,
+  OR,
+  NONE,
+  TRUE,
+  FALSE,
+  BREAK,
+  CONTINUE,
+  OPEN_PAREN,
+  CLOSE_PAREN,
+  OPEN_BRACE,
+  CLOSE_BRACE,
+  COMMA,
+  COLON,
+  ASSIGN,
+  ADD,
+  MINUS,
+  STAR,
+  DIV,
+  IDIV,
+  MOD,
+  LESS_THAN,
+  GREATER_THAN,
+  EQUALS,
+  GT_EQ,
+  LT_EQ,
+  NOT_EQ,
+  ADD_ASSIGN,
+  SUB_ASSIGN,
+  MULT_ASSIGN,
+  DIV_ASSIGN,
+  IDIV_ASSIGN,
+  MOD_ASSIGN,
+};
+
+struct Token {
+  TokenType type;
+  int line;
+  // the token's text is source[start, start + length)
+  uint32_t start;
+  uint32_t length;
+};
+
+// A tokenizer that follows Python3Lexer.g4 rule for rule: the same
+// NEWLINE/INDENT/DEDENT logic (tabs to multiples of 8, newlines ignored
+// inside brackets and before blank or comment lines), the same f-string
+// modes and the same longest-match choices. Where the ANTLR lexer would
+// produce something this front end does not support, it throws
+// runtime_error instead, and the caller falls back to ANTLR.
+class Tokenizer {
+public:
+  Tokenizer(const char *data, size_t size);
+
+  std::vector<Token> tokenize();
+
+private:
+  const char *data;
+  size_t size;
+  size_t pos = 0;
+  int line = 1;
+  std::vector<Token> tokens;
+  std::vector<int> indents;
+  int opened = 0;
+  int formatMode = 0;
+  bool exprMode = false;
+
+  int peekChar(size_t offset = 0) const {
+    return pos + offset < size ? (unsigned char)data[pos + offset] : -1;
+  }
+  void push(TokenType type, size_t start, int startLine);
+  [[noreturn]] void fail(const char *what) const;
+
+  void lexNewline();
+  void lexFormatLiteral();
+  void lexNumber();
+  void lexName();
+  void lexString();
+  void lexOperator();
+
+  // Length of the NUMBER the ANTLR lexer would match at from, or 0;
+  // supported is cleared for hex, octal, binary and imaginary literals.
+  size_t scanNumber(size_t from, bool &supported) const;
+};
+
+#endif//PYTHON_INTERPRETER_TOKENIZER_H
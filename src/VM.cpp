@@ -0,0 +1,521 @@
+#include "VM.h"
+#include "Profiler.h"
+#include "Memory.h"
+#include "Stats.h"
+#include "Output.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+static bool compareSmall(BinaryOp op, long long left, long long right) {
+  switch (op) {
+    case BinaryOp::LT: return left < right;
+    case BinaryOp::GT: return left > right;
+    case BinaryOp::LE: return left <= right;
+    case BinaryOp::GE: return left >= right;
+    case BinaryOp::EQ: return left == right;
+    default: return left != right;
+  }
+}
+
+// false if the result does not fit in a long long
+static bool updateSmall(BinaryOp op, long long left, long long right, long long &result) {
+  switch (op) {
+    case BinaryOp::ADD: return !__builtin_add_overflow(left, right, &result);
+    case BinaryOp::SUB: return !__builtin_sub_overflow(left, right, &result);
+    default: return !__builtin_mul_overflow(left, right, &result);
+  }
+}
+
+static bool smallInt(const Value &value, long long &out) {
+  return value.type() == Value::INT && value.asInt().to_small(out);
+}
+
+VM::VM(const Module &module)
+    : module(module), globals(module.globals.size()), functions(module.names.size()),
+      callBindings(module.callSites.size()) {
+  // sized from the code itself, so any b a cached module carries is in range
+  binaryCaches.resize(module.codes.size());
+  for (size_t i = 0; i < module.codes.size(); ++i) {
+    const CodeObject &code = module.codes[i];
+    size_t count = 0;
+    for (uint32_t at = 0; at < code.size; ++at) {
+      if (code.code[at].op == Op::BINARY) {
+        count = std::max(count, (size_t)code.code[at].b + 1);
+      }
+    }
+    binaryCaches[i].resize(count);
+  }
+}
+
+size_t VM::KeyHash::operator()(const std::vector<Value> &key) const {
+  size_t h = key.size();
+  for (auto &value : key) {
+    h = h * 1000003 ^ hashValue(value);
+  }
+  return h;
+}
+
+bool VM::KeyEqual::operator()(const std::vector<Value> &left, const std::vector<Value> &right) const {
+  if (left.size() != right.size()) return false;
+  for (size_t i = 0; i < left.size(); ++i) {
+    if (!identical(left[i], right[i])) return false;
+  }
+  return true;
+}
+
+void VM::setMemoize(bool enabled) {
+  memoTables.clear();
+  memoTables.resize(module.codes.size());
+  for (size_t i = 0; enabled && i < module.codes.size(); ++i) {
+    if (module.codes[i].pure) memoTables[i] = std::make_unique<MemoTable>();
+  }
+}
+
+void VM::setProfiler(Profiler *profiler) {
+  this->profiler = profiler;
+  profileIds.clear();
+  for (size_t i = 0; profiler && i < module.codes.size(); ++i) {
+    profileIds.push_back(profiler->function(module.codes[i].name));
+  }
+}
+
+void VM::run() {
+  try {
+    pushFrame(module.codes[0], 0);
+    if (profiler) profiler->enter(profileIds[0]);
+    if (profiler || stats().enabled) {
+      execute<true>();
+    } else {
+      execute<false>();
+    }
+  } catch (const std::runtime_error &e) {
+    output().flush();
+    std::cerr << "Runtime Error: " << e.what() << std::endl;
+    exit(1);
+  } catch (const std::bad_alloc &) {
+    output().flush();
+    std::cerr << "Runtime Error: MemoryError" << std::endl;
+    exit(1);
+  } catch (const std::exception &e) {
+    output().flush();
+    std::cerr << "Runtime Error: " << e.what() << std::endl;
+    exit(1);
+  }
+}
+
+void VM::reserveFrameSlots(size_t count) {
+  if (count <= frameSlots.capacity()) return;
+  size_t capacity = std::max(count, 2 * frameSlots.capacity());
+  memoryBudget().charge(MemoryBudget::FRAMES, (capacity - frameSlots.capacity()) * sizeof(Value));
+  frameSlots.reserve(capacity);
+}
+
+void VM::pushFrame(const CodeObject &code, size_t localsBase) {
+  if (frames.size() >= recursionLimit) {
+    throw std::runtime_error("RecursionError: maximum recursion depth exceeded");
+  }
+  if (frames.size() == frames.capacity()) {
+    size_t capacity = std::max<size_t>(16, 2 * frames.capacity());
+    memoryBudget().charge(MemoryBudget::FRAMES, (capacity - frames.capacity()) * sizeof(Frame));
+    frames.reserve(capacity);
+  }
+  Frame frame;
+  frame.code = &code;
+  frame.pc = code.code;
+  frame.caches = binaryCaches[&code - module.codes.data()].data();
+  frame.localsBase = localsBase;
+  frame.stackBase = stack.size();
+  frames.push_back(std::move(frame));
+}
+
+template <bool INSTRUMENTED>
+void VM::execute() {
+  // the running frame, cached in locals of this function; reloaded whenever
+  // a call or a return changes frames.back()
+  const CodeObject *code;
+  const Instruction *pc;
+  BinaryCache *caches;
+  Value *locals;
+  auto enter = [&]() {
+    Frame &frame = frames.back();
+    code = frame.code;
+    pc = frame.pc;
+    caches = frame.caches;
+    locals = frameSlots.data() + frame.localsBase;
+  };
+  size_t bottom = frames.size() - 1;
+  enter();
+  auto slot = [&](int kind, int32_t index) -> const Value & {
+    if (kind == LOCAL_SLOT) return locals[index];
+    if (kind == GLOBAL_SLOT) return globals[index];
+    return module.constants[index];
+  };
+  RuntimeStats *counters = INSTRUMENTED && stats().enabled ? &stats() : nullptr;
+  auto countRead = [&](int kind) {
+    if (kind == LOCAL_SLOT) counters->localReads++;
+    if (kind == GLOBAL_SLOT) counters->globalReads++;
+  };
+  for (;;) {
+    if (INSTRUMENTED && profiler) profiler->line(code->lines[pc - code->code]);
+    const Instruction &ins = *pc++;
+    switch (ins.op) {
+      case Op::NOP:
+        break;
+      case Op::LOAD_CONST:
+        stack.push_back(module.constants[ins.a]);
+        break;
+      case Op::LOAD_GLOBAL:
+        if (INSTRUMENTED && counters) counters->globalReads++;
+        if (globals[ins.a].isBound()) {
+          stack.push_back(globals[ins.a]);
+        } else {
+          stack.push_back(Value(Undefined{}));
+        }
+        break;
+      case Op::STORE_GLOBAL:
+        globals[ins.a] = std::move(stack.back());
+        stack.pop_back();
+        break;
+      case Op::LOAD_NAME:
+        if (INSTRUMENTED && counters) countRead(locals[ins.a].isBound() ? LOCAL_SLOT : GLOBAL_SLOT);
+        if (locals[ins.a].isBound()) {
+          stack.push_back(locals[ins.a]);
+        } else if (globals[ins.b].isBound()) {
+          stack.push_back(globals[ins.b]);
+        } else {
+          stack.push_back(Value(Undefined{}));
+        }
+        break;
+      case Op::STORE_NAME: {
+        Value &target = !locals[ins.a].isBound() && globals[ins.b].isBound() ? globals[ins.b] : locals[ins.a];
+        target = std::move(stack.back());
+        stack.pop_back();
+        break;
+      }
+      case Op::POP_TOP:
+        stack.pop_back();
+        break;
+      case Op::DUP_TOP:
+        stack.push_back(stack.back());
+        break;
+      case Op::ROT_TWO:
+        std::swap(stack[stack.size() - 1], stack[stack.size() - 2]);
+        break;
+      case Op::ROT_THREE:
+        std::rotate(stack.end() - 3, stack.end() - 1, stack.end());
+        break;
+      case Op::BINARY: {
+        Value &left = stack[stack.size() - 2];
+        const Value &right = stack.back();
+        BinaryCache &cache = caches[ins.b];
+        if (INSTRUMENTED && counters) counters->countBinary(static_cast<BinaryOp>(ins.a), left.type(), right.type());
+        if (left.type() != cache.left || right.type() != cache.right) {
+          cache.left = left.type();
+          cache.right = right.type();
+          cache.kernel = binaryKernel(static_cast<BinaryOp>(ins.a), cache.left, cache.right);
+        }
+        if (cache.kernel) {
+          cache.kernel(left, right);
+        } else {
+          left = binaryOp(static_cast<BinaryOp>(ins.a), left, right);
+        }
+        stack.pop_back();
+        break;
+      }
+      case Op::UNARY_PLUS:
+        stack.back() = unaryPlus(stack.back());
+        break;
+      case Op::UNARY_MINUS:
+        stack.back() = unaryMinus(stack.back());
+        break;
+      case Op::NOT:
+        stack.back() = Value(!toBool(stack.back()));
+        break;
+      case Op::TO_BOOL:
+        stack.back() = Value(toBool(stack.back()));
+        break;
+      case Op::JUMP:
+        pc = code->code + ins.a;
+        break;
+      case Op::POP_JUMP_IF_FALSE: {
+        bool condition = toBool(stack.back());
+        stack.pop_back();
+        if (!condition) pc = code->code + ins.a;
+        break;
+      }
+      case Op::JUMP_IF_FALSE_OR_POP:
+        if (!toBool(stack.back())) {
+          pc = code->code + ins.a;
+        } else {
+          stack.pop_back();
+        }
+        break;
+      case Op::JUMP_IF_TRUE_OR_POP:
+        if (toBool(stack.back())) {
+          pc = code->code + ins.a;
+        } else {
+          stack.pop_back();
+        }
+        break;
+      case Op::BUILD_TUPLE: {
+        Tuple tuple;
+        tuple.reserve(ins.a);
+        for (auto it = stack.end() - ins.a; it != stack.end(); ++it) {
+          if (it->type() == Value::TUPLE) {
+            tuple.insert(tuple.end(), it->asTuple().begin(), it->asTuple().end());
+          } else {
+            tuple.push_back(std::move(*it));
+          }
+        }
+        stack.resize(stack.size() - ins.a);
+        stack.push_back(Value(std::move(tuple)));
+        break;
+      }
+      case Op::UNPACK: {
+        Value packed = std::move(stack.back());
+        stack.pop_back();
+        const Tuple &tuple = packed.asTuple();
+        if (tuple.size() < (size_t)ins.a) {
+          throw std::runtime_error("ValueError: not enough values to unpack (expected " + std::to_string(ins.a) +
+                                   ", got " + std::to_string(tuple.size()) + ")");
+        }
+        for (int i = ins.a - 1; i >= 0; --i) {
+          stack.push_back(tuple[i]);
+        }
+        break;
+      }
+      case Op::BUILD_STRING: {
+        std::string result;
+        for (auto it = stack.end() - ins.a; it != stack.end(); ++it) {
+          appendStr(result, *it);
+        }
+        stack.resize(stack.size() - ins.a);
+        stack.push_back(Value(std::move(result)));
+        break;
+      }
+      case Op::CALL: {
+        frames.back().pc = pc;
+        size_t depth = frames.size();
+        call(module.callSites[ins.a]);
+        if (INSTRUMENTED && counters) {
+          counters->countCall(depth);
+          counters->countFrameSlots(frameSlots.size());
+        }
+        // a memoized result pushes no frame
+        if (INSTRUMENTED && profiler && frames.size() > depth) {
+          profiler->enter(profileIds[frames.back().code - module.codes.data()]);
+        }
+        enter();
+        break;
+      }
+      case Op::CALL_BUILTIN: {
+        Value result = callBuiltin(static_cast<Builtin>(ins.a), stack.data() + stack.size() - ins.b, ins.b);
+        stack.resize(stack.size() - ins.b);
+        stack.push_back(std::move(result));
+        break;
+      }
+      case Op::DEF_FUNCTION: {
+        Function function;
+        function.code = &module.codes[ins.a];
+        size_t count = function.code->numDefaults;
+        function.defaults.assign(std::make_move_iterator(stack.end() - count), std::make_move_iterator(stack.end()));
+        stack.resize(stack.size() - count);
+        functions[ins.b] = std::move(function);
+        break;
+      }
+      case Op::RETURN_VALUE: {
+        // leave the result where the callee's arguments were
+        size_t base = frames.back().stackBase;
+        if (stack.size() != base + 1) {
+          stack[base] = std::move(stack.back());
+          stack.resize(base + 1);
+        }
+        if (frames.back().memo) {
+          frames.back().memo->emplace(std::move(frames.back().memoKey), stack[base]);
+        }
+        if (INSTRUMENTED && profiler) profiler->leave();
+        frameSlots.resize(frames.back().localsBase);
+        frames.pop_back();
+        if (frames.size() == bottom) return;
+        enter();
+        break;
+      }
+      case Op::COMPARE_JUMP: {
+        long long left, right;
+        if (smallInt(slot(ins.kinds & 3, ins.a), left) && smallInt(slot(ins.kinds >> 2, ins.b), right)) {
+          if (INSTRUMENTED && counters) {
+            countRead(ins.kinds & 3);
+            countRead(ins.kinds >> 2);
+            counters->countBinary(static_cast<BinaryOp>(ins.c), Value::INT, Value::INT);
+          }
+          // pc[3] is the POP_JUMP_IF_FALSE ending the generic instructions
+          pc = compareSmall(static_cast<BinaryOp>(ins.c), left, right) ? pc + 4 : code->code + pc[3].a;
+        }
+        break;
+      }
+      case Op::UPDATE: {
+        Value &target = (ins.kinds & 3) == LOCAL_SLOT ? locals[ins.a] : globals[ins.a];
+        long long left, right, result;
+        if (smallInt(target, left) && smallInt(slot(ins.kinds >> 2, ins.b), right) &&
+            updateSmall(static_cast<BinaryOp>(ins.c), left, right, result)) {
+          target.mutableInt().assign_small(result);
+          pc += 4;
+          if (INSTRUMENTED && counters) {
+            countRead(ins.kinds & 3);
+            countRead(ins.kinds >> 2);
+            counters->countBinary(static_cast<BinaryOp>(ins.c), Value::INT, Value::INT);
+          }
+        }
+        break;
+      }
+      default:
+        throw std::runtime_error("Invalid instruction");
+    }
+  }
+}
+
+void VM::bind(CallBinding &binding, const CallSite &site, const CodeObject &code) {
+  const std::string &name = module.names[site.name];
+  size_t argc = site.keywords.size();
+  binding.code = nullptr;
+  binding.slots.resize(argc);
+  for (size_t i = 0; i < argc; ++i) {
+    size_t slot = i;
+    if (site.keywords[i] >= 0) {
+      const std::string &keyword = module.names[site.keywords[i]];
+      slot = std::find(code.locals.begin(), code.locals.begin() + code.numParams, keyword) - code.locals.begin();
+      if (slot == code.numParams) {
+        throw std::runtime_error("TypeError: " + name + "() got an unexpected keyword argument '" + keyword + "'");
+      }
+    } else if (slot >= code.numParams) {
+      throw std::runtime_error("TypeError: " + name + "() takes " + std::to_string(code.numParams) +
+                               " positional arguments but " + std::to_string(argc) + " were given");
+    }
+    binding.slots[i] = slot;
+  }
+  binding.code = &code;
+}
+
+void VM::call(const CallSite &site) {
+  const Function &function = functions[site.name];
+  if (!function.code) {
+    const std::string &name = module.names[site.name];
+    Builtin builtin = findBuiltin(name, true);
+    if (builtin == Builtin::BUILTIN_COUNT) {
+      throw std::runtime_error("Function '" + name + "' not defined");
+    }
+    for (int32_t keyword : site.keywords) {
+      if (keyword >= 0) throw std::runtime_error("TypeError: " + name + "() takes no keyword arguments");
+    }
+    size_t argc = site.keywords.size();
+    Value result = callBuiltin(builtin, stack.data() + stack.size() - argc, argc);
+    stack.resize(stack.size() - argc);
+    stack.push_back(std::move(result));
+    return;
+  }
+  const CodeObject &code = *function.code;
+  CallBinding &binding = callBindings[&site - module.callSites.data()];
+  if (binding.code != &code) bind(binding, site, code);
+
+  // move the arguments off the stack into the new frame before running it,
+  // since the callee pushes onto the same stack
+  size_t argc = binding.slots.size();
+  Value *args = stack.data() + stack.size() - argc;
+  size_t base = frameSlots.size();
+  reserveFrameSlots(base + code.locals.size());
+  frameSlots.resize(base + code.locals.size());
+  Value *locals = frameSlots.data() + base;
+  for (size_t i = 0; i < argc; ++i) {
+    locals[binding.slots[i]] = std::move(args[i]);
+  }
+  stack.resize(stack.size() - argc);
+
+  size_t firstDefault = code.numParams - code.numDefaults;
+  for (size_t i = 0; i < code.numParams; ++i) {
+    if (locals[i].isBound()) continue;
+    if (i < firstDefault) {
+      throw std::runtime_error("Function '" + module.names[site.name] + "' missing required argument: " +
+                               code.locals[i]);
+    }
+    locals[i] = function.defaults[i - firstDefault];
+  }
+  MemoTable *memo = memoTables.empty() ? nullptr : memoTables[&code - module.codes.data()].get();
+  if (!memo) {
+    pushFrame(code, base);
+    return;
+  }
+  std::vector<Value> key(locals, locals + code.numParams);
+  auto cached = memo->find(key);
+  if (cached != memo->end()) {
+    stack.push_back(cached->second);
+    frameSlots.resize(base);
+    return;
+  }
+  pushFrame(code, base);
+  frames.back().memo = memo;
+  frames.back().memoKey = std::move(key);
+}
+
+Value VM::callBuiltin(Builtin builtin, Value *args, size_t argc) {
+  if (builtin == Builtin::PRINT) {
+    print(args, argc);
+    return Value(None{});
+  }
+  if (argc != 1) {
+    throw std::runtime_error(std::string("Too many arguments for ") + builtinName(builtin) + "()");
+  }
+  switch (builtin) {
+    case Builtin::INT:
+      return Value(toInt(args[0]));
+    case Builtin::FLOAT:
+      return Value(toDouble(args[0]));
+    case Builtin::STR:
+      return Value(toStr(args[0]));
+    case Builtin::BOOL:
+      return Value(toBool(args[0]));
+    case Builtin::FACTORIAL:
+      if (args[0].type() != Value::INT && args[0].type() != Value::BOOL) {
+        throw std::runtime_error("TypeError: factorial() argument must be an int");
+      }
+      return Value(factorialOf(toInt(args[0])));
+    default:
+      throw std::runtime_error(std::string("System function '") + builtinName(builtin) + "' not implemented");
+  }
+}
+
+void VM::print(const Value *args, size_t argc) {
+  Output &out = output();
+  bool first = true;
+  auto write = [&](const Value &value) {
+    if (!first) out.put(' ');
+    first = false;
+    switch (value.type()) {
+      case Value::STR:
+        out.writeEscaped(value.asStr().data(), value.asStr().size());
+        break;
+      case Value::INT:
+        out.writeInt(value.asInt());
+        break;
+      case Value::FLOAT:
+        out.writeDouble(value.asFloat());
+        break;
+      case Value::BOOL:
+        out.write(value.asBool() ? "True" : "False", value.asBool() ? 4 : 5);
+        break;
+      case Value::NONE:
+        out.write("None", 4);
+        break;
+      default:
+        break;
+    }
+  };
+  for (size_t i = 0; i < argc; ++i) {
+    if (args[i].type() == Value::TUPLE) {
+      for (auto &element : args[i].asTuple()) write(element);
+    } else {
+      write(args[i]);
+    }
+  }
+  out.endLine();
+}
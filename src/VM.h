@@ -0,0 +1,121 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_VM_H
+#define PYTHON_INTERPRETER_VM_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Bytecode.h"
+
+class Profiler;
+
+// Executes a compiled Module. The observable behaviour (output, scoping,
+// error messages) is the same as running the script through EvalVisitor.
+class VM {
+public:
+  // Python calls do not use the native stack, so the default is far above
+  // CPython's; it only bounds runaway recursion.
+  static const size_t DEFAULT_RECURSION_LIMIT = 100000;
+
+  explicit VM(const Module &module);
+
+  // Calls nested deeper than limit frames (counting the module body) raise
+  // RecursionError.
+  void setRecursionLimit(size_t limit) { recursionLimit = limit; }
+
+  // Cache the results of pure functions (CodeObject::pure), keyed by the
+  // values of their parameters.
+  void setMemoize(bool enabled);
+
+  // Report lines and calls to profiler while running; null turns it off.
+  void setProfiler(Profiler *profiler);
+
+  // Run the module body. A runtime error is reported on stderr as
+  // "Runtime Error: ..." and ends the process with status 1.
+  void run();
+
+private:
+  struct Function {
+    const CodeObject *code = nullptr;
+    std::vector<Value> defaults;
+  };
+
+  // Monomorphic inline cache of one BINARY instruction: the operand types
+  // it last saw and the kernel for them (nullptr: use binaryOp).
+  struct BinaryCache {
+    Value::Type left = Value::UNBOUND;
+    Value::Type right = Value::UNBOUND;
+    BinaryKernel kernel = nullptr;
+  };
+
+  // A call site's arguments resolved against the function it last called:
+  // slots[i] is the parameter that argument i binds.
+  struct CallBinding {
+    const CodeObject *code = nullptr;
+    std::vector<uint32_t> slots;
+  };
+
+  struct KeyHash {
+    size_t operator()(const std::vector<Value> &key) const;
+  };
+  struct KeyEqual {
+    bool operator()(const std::vector<Value> &left, const std::vector<Value> &right) const;
+  };
+  using MemoTable = std::unordered_map<std::vector<Value>, Value, KeyHash, KeyEqual>;
+
+  // An active call. Frames live in a vector rather than on the native
+  // stack, so recursion depth is only limited by memory.
+  struct Frame {
+    const CodeObject *code;
+    // the next instruction, saved while a callee runs
+    const Instruction *pc;
+    BinaryCache *caches;
+    // where its locals start in frameSlots
+    size_t localsBase;
+    // operand stack height when the frame was entered
+    size_t stackBase;
+    // where to record the result under memoKey, if the call is memoized
+    MemoTable *memo = nullptr;
+    std::vector<Value> memoKey;
+  };
+
+  const Module &module;
+  // per code object, indexed by the b operand of its BINARY instructions
+  std::vector<std::vector<BinaryCache>> binaryCaches;
+  std::vector<Value> globals;
+  // indexed by Module::names; code is null until a def binds the name
+  std::vector<Function> functions;
+  // indexed like Module::callSites
+  std::vector<CallBinding> callBindings;
+  // operand stack shared by all frames
+  std::vector<Value> stack;
+  std::vector<Frame> frames;
+  // The locals of all frames, innermost last. A call claims the next
+  // code.locals.size() slots and its return releases them, so once the
+  // deepest recursion has been reached calls allocate nothing.
+  std::vector<Value> frameSlots;
+  // per code object; null unless memoizing a pure function
+  std::vector<std::unique_ptr<MemoTable>> memoTables;
+  size_t recursionLimit = DEFAULT_RECURSION_LIMIT;
+  Profiler *profiler = nullptr;
+  // Profiler function id of each code object
+  std::vector<int> profileIds;
+
+  // Run frames until the bottom one returns. The INSTRUMENTED instance also
+  // reports lines and calls to the profiler and updates stats(), when they
+  // are on; the other one does neither and pays nothing for them.
+  template <bool INSTRUMENTED>
+  void execute();
+  void pushFrame(const CodeObject &code, size_t localsBase);
+  // Make room for count frame slots, charging growth to the memory budget.
+  void reserveFrameSlots(size_t count);
+  void bind(CallBinding &binding, const CallSite &site, const CodeObject &code);
+  // Enter a user function; its arguments are the topmost values on the
+  // stack and are replaced by its return value once its frame returns.
+  void call(const CallSite &site);
+  Value callBuiltin(Builtin builtin, Value *args, size_t argc);
+  void print(const Value *args, size_t argc);
+};
+
+#endif//PYTHON_INTERPRETER_VM_H
@@ -0,0 +1,372 @@
+#include "Value.h"
+#include "FloatFormat.h"
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+const char *binaryOpName(BinaryOp op) {
+  switch (op) {
+    case BinaryOp::ADD: return "+";
+    case BinaryOp::SUB: return "-";
+    case BinaryOp::MUL: return "*";
+    case BinaryOp::DIV: return "/";
+    case BinaryOp::IDIV: return "//";
+    case BinaryOp::MOD: return "%";
+    case BinaryOp::LT: return "<";
+    case BinaryOp::GT: return ">";
+    case BinaryOp::LE: return "<=";
+    case BinaryOp::GE: return ">=";
+    case BinaryOp::EQ: return "==";
+    case BinaryOp::NE: return "!=";
+  }
+  return "?";
+}
+
+sjtu::int2048 toInt(const Value &value) {
+  switch (value.type()) {
+    case Value::INT: return value.asInt();
+    case Value::FLOAT: return sjtu::int2048((long long)value.asFloat());
+    case Value::STR: return sjtu::int2048(value.asStr());
+    case Value::BOOL: return sjtu::int2048(value.asBool() ? 1 : 0);
+    default: return sjtu::int2048();
+  }
+}
+
+sjtu::int2048 factorialOf(const sjtu::int2048 &n) {
+  if (n.sign < 0) throw std::runtime_error("ValueError: factorial() not defined for negative values");
+  long long k;
+  if (!n.to_small(k)) throw std::runtime_error("OverflowError: factorial() argument is too large");
+  return sjtu::factorial(k);
+}
+
+double toDouble(const Value &value) {
+  switch (value.type()) {
+    case Value::FLOAT: return value.asFloat();
+    case Value::INT: return value.asInt().to_double();
+    case Value::STR:
+      try {
+        return std::stod(value.asStr());
+      } catch (const std::logic_error &) {
+        throw std::runtime_error("ValueError: could not convert string to float: '" + value.asStr() + "'");
+      }
+    case Value::BOOL: return value.asBool() ? 1.0 : 0.0;
+    default: return 0.0;
+  }
+}
+
+bool toBool(const Value &value) {
+  switch (value.type()) {
+    case Value::BOOL: return value.asBool();
+    case Value::INT: return value.asInt().sign != 0;
+    case Value::FLOAT: return value.asFloat() != 0.0;
+    case Value::STR: return !value.asStr().empty();
+    default: return false;
+  }
+}
+
+std::string toStr(const Value &value) {
+  if (value.type() == Value::STR) return value.asStr();
+  if (value.type() == Value::TUPLE) return std::string();
+  std::string ret;
+  appendStr(ret, value);
+  return ret;
+}
+
+void appendStr(std::string &out, const Value &value) {
+  switch (value.type()) {
+    case Value::STR: out += value.asStr(); break;
+    case Value::INT: value.asInt().append_to(out); break;
+    case Value::FLOAT: appendDouble(out, value.asFloat()); break;
+    case Value::BOOL: out += value.asBool() ? "True" : "False"; break;
+    case Value::NONE: out += "None"; break;
+    case Value::TUPLE:
+      for (auto &element : value.asTuple()) {
+        appendStr(out, element);
+      }
+      break;
+    default: break;
+  }
+}
+
+size_t hashValue(const Value &value) {
+  size_t h = value.type();
+  switch (value.type()) {
+    case Value::BOOL: return h * 31 + value.asBool();
+    case Value::INT: return h * 31 + value.asInt().hash();
+    case Value::FLOAT: {
+      uint64_t bits;
+      double f = value.asFloat();
+      memcpy(&bits, &f, sizeof(bits));
+      return h * 31 + std::hash<uint64_t>()(bits);
+    }
+    case Value::STR: return h * 31 + std::hash<std::string>()(value.asStr());
+    case Value::TUPLE:
+      for (auto &element : value.asTuple()) {
+        h = h * 31 + hashValue(element);
+      }
+      return h;
+    default: return h;
+  }
+}
+
+bool identical(const Value &left, const Value &right) {
+  if (left.type() != right.type()) return false;
+  switch (left.type()) {
+    case Value::BOOL: return left.asBool() == right.asBool();
+    case Value::INT: return left.asInt() == right.asInt();
+    case Value::FLOAT: {
+      double a = left.asFloat(), b = right.asFloat();
+      return memcmp(&a, &b, sizeof(a)) == 0;
+    }
+    case Value::STR: return left.asStr() == right.asStr();
+    case Value::TUPLE: {
+      const Tuple &a = left.asTuple(), &b = right.asTuple();
+      if (a.size() != b.size()) return false;
+      for (size_t i = 0; i < a.size(); ++i) {
+        if (!identical(a[i], b[i])) return false;
+      }
+      return true;
+    }
+    default: return true;
+  }
+}
+
+static Value repeat(const std::string &str, const sjtu::int2048 &times) {
+  if (times.sign <= 0) return Value(std::string());
+  memoryBudget().check(times.to_double() * str.size());
+  long long count = (long long)times.to_double();
+  std::string result;
+  result.reserve(str.size() * count);
+  for (long long i = 0; i < count; ++i) {
+    result += str;
+  }
+  return Value(std::move(result));
+}
+
+// Both operands are known not to be strings: compare as floats if either is
+// a float, otherwise as integers.
+static bool numericLess(const Value &left, const Value &right) {
+  if (left.type() == Value::FLOAT || right.type() == Value::FLOAT) {
+    return toDouble(left) < toDouble(right);
+  }
+  return toInt(left) < toInt(right);
+}
+
+static bool lessThan(const Value &left, const Value &right, const char *op) {
+  bool leftStr = left.type() == Value::STR, rightStr = right.type() == Value::STR;
+  if (leftStr && rightStr) return left.asStr() < right.asStr();
+  if (leftStr || rightStr) {
+    throw std::runtime_error(std::string("TypeError: '") + op + "' not supported between instances of 'str' and non-str");
+  }
+  return numericLess(left, right);
+}
+
+static bool equals(const Value &left, const Value &right) {
+  bool leftStr = left.type() == Value::STR, rightStr = right.type() == Value::STR;
+  if (leftStr && rightStr) return left.asStr() == right.asStr();
+  if (leftStr || rightStr) return false;
+  if (left.type() == Value::FLOAT || right.type() == Value::FLOAT) {
+    return toDouble(left) == toDouble(right);
+  }
+  if (left.type() == Value::NONE || right.type() == Value::NONE) {
+    return left.type() == Value::NONE && right.type() == Value::NONE;
+  }
+  return toInt(left) == toInt(right);
+}
+
+Value binaryOp(BinaryOp op, const Value &left, const Value &right) {
+  bool leftStr = left.type() == Value::STR, rightStr = right.type() == Value::STR;
+  bool anyFloat = left.type() == Value::FLOAT || right.type() == Value::FLOAT;
+  switch (op) {
+    case BinaryOp::ADD:
+      if (leftStr && rightStr) {
+        memoryBudget().check((double)left.asStr().size() + right.asStr().size());
+        return Value(left.asStr() + right.asStr());
+      }
+      if (leftStr || rightStr) {
+        throw std::runtime_error("TypeError: unsupported operand type(s) for +: 'str' and non-str");
+      }
+      if (anyFloat) return Value(toDouble(left) + toDouble(right));
+      return Value(toInt(left) + toInt(right));
+
+    case BinaryOp::SUB:
+      if (leftStr || rightStr) {
+        throw std::runtime_error("TypeError: unsupported operand type(s) for -: 'str'");
+      }
+      if (anyFloat) return Value(toDouble(left) - toDouble(right));
+      return Value(toInt(left) - toInt(right));
+
+    case BinaryOp::MUL:
+      if (leftStr && right.type() == Value::INT) return repeat(left.asStr(), right.asInt());
+      if (rightStr && left.type() == Value::INT) return repeat(right.asStr(), left.asInt());
+      if (leftStr && right.type() == Value::BOOL) return repeat(left.asStr(), sjtu::int2048(right.asBool() ? 1 : 0));
+      if (leftStr || rightStr) {
+        throw std::runtime_error("TypeError: unsupported operand type(s) for *: 'str' and non-int");
+      }
+      if (anyFloat) return Value(toDouble(left) * toDouble(right));
+      return Value(toInt(left) * toInt(right));
+
+    case BinaryOp::DIV: {
+      if (leftStr || rightStr) {
+        throw std::runtime_error("TypeError: unsupported operand type(s) for /: 'str'");
+      }
+      double divisor = toDouble(right);
+      if (divisor == 0.0) throw std::runtime_error("Division by zero");
+      return Value(toDouble(left) / divisor);
+    }
+
+    case BinaryOp::IDIV: {
+      if (leftStr || rightStr) {
+        throw std::runtime_error("TypeError: unsupported operand type(s) for //: 'str'");
+      }
+      if (anyFloat) {
+        double divisor = toDouble(right);
+        if (divisor == 0.0) throw std::runtime_error("Division by zero");
+        return Value(std::floor(toDouble(left) / divisor));
+      }
+      sjtu::int2048 divisor = toInt(right);
+      if (divisor.sign == 0) throw std::runtime_error("Division by zero");
+      return Value(toInt(left) / divisor);
+    }
+
+    case BinaryOp::MOD: {
+      if (leftStr || rightStr) {
+        throw std::runtime_error("TypeError: unsupported operand type(s) for %: 'str'");
+      }
+      if (left.type() == Value::INT && right.type() == Value::INT) {
+        if (right.asInt().sign == 0) throw std::runtime_error("Modulo by zero");
+        return Value(left.asInt() % right.asInt());
+      }
+      double divisor = toDouble(right);
+      if (divisor == 0.0) throw std::runtime_error("Modulo by zero");
+      return Value(std::fmod(toDouble(left), divisor));
+    }
+
+    case BinaryOp::LT: return Value(lessThan(left, right, "<"));
+    case BinaryOp::GT: return Value(lessThan(right, left, ">"));
+    case BinaryOp::GE: return Value(!lessThan(left, right, "<"));
+    case BinaryOp::LE: return Value(!lessThan(right, left, ">"));
+    case BinaryOp::EQ: return Value(equals(left, right));
+    case BinaryOp::NE: return Value(!equals(left, right));
+  }
+  throw std::runtime_error(std::string("Invalid operator: ") + binaryOpName(op));
+}
+
+// int op int
+static void intAdd(Value &left, const Value &right) { left.mutableInt() += right.asInt(); }
+static void intSub(Value &left, const Value &right) { left.mutableInt() -= right.asInt(); }
+static void intMul(Value &left, const Value &right) { left.mutableInt() *= right.asInt(); }
+static void intDiv(Value &left, const Value &right) {
+  double divisor = right.asInt().to_double();
+  if (divisor == 0.0) throw std::runtime_error("Division by zero");
+  left = Value(left.asInt().to_double() / divisor);
+}
+static void intIdiv(Value &left, const Value &right) {
+  if (right.asInt().sign == 0) throw std::runtime_error("Division by zero");
+  left.mutableInt() /= right.asInt();
+}
+static void intMod(Value &left, const Value &right) {
+  if (right.asInt().sign == 0) throw std::runtime_error("Modulo by zero");
+  left.mutableInt() %= right.asInt();
+}
+static void intLt(Value &left, const Value &right) { left = Value(left.asInt() < right.asInt()); }
+static void intGt(Value &left, const Value &right) { left = Value(right.asInt() < left.asInt()); }
+static void intLe(Value &left, const Value &right) { left = Value(!(right.asInt() < left.asInt())); }
+static void intGe(Value &left, const Value &right) { left = Value(!(left.asInt() < right.asInt())); }
+static void intEq(Value &left, const Value &right) { left = Value(left.asInt() == right.asInt()); }
+static void intNe(Value &left, const Value &right) { left = Value(!(left.asInt() == right.asInt())); }
+
+// float op float
+static void floatAdd(Value &left, const Value &right) { left = Value(left.asFloat() + right.asFloat()); }
+static void floatSub(Value &left, const Value &right) { left = Value(left.asFloat() - right.asFloat()); }
+static void floatMul(Value &left, const Value &right) { left = Value(left.asFloat() * right.asFloat()); }
+static void floatDiv(Value &left, const Value &right) {
+  if (right.asFloat() == 0.0) throw std::runtime_error("Division by zero");
+  left = Value(left.asFloat() / right.asFloat());
+}
+static void floatLt(Value &left, const Value &right) { left = Value(left.asFloat() < right.asFloat()); }
+static void floatGt(Value &left, const Value &right) { left = Value(right.asFloat() < left.asFloat()); }
+static void floatLe(Value &left, const Value &right) { left = Value(!(right.asFloat() < left.asFloat())); }
+static void floatGe(Value &left, const Value &right) { left = Value(!(left.asFloat() < right.asFloat())); }
+
+// str op str
+static void strAdd(Value &left, const Value &right) {
+  memoryBudget().check((double)left.asStr().size() + right.asStr().size());
+  left.mutableStr() += right.asStr();
+  left.rechargeStr();
+}
+static void strLt(Value &left, const Value &right) { left = Value(left.asStr() < right.asStr()); }
+static void strGt(Value &left, const Value &right) { left = Value(right.asStr() < left.asStr()); }
+static void strLe(Value &left, const Value &right) { left = Value(!(right.asStr() < left.asStr())); }
+static void strGe(Value &left, const Value &right) { left = Value(!(left.asStr() < right.asStr())); }
+static void strEq(Value &left, const Value &right) { left = Value(left.asStr() == right.asStr()); }
+static void strNe(Value &left, const Value &right) { left = Value(!(left.asStr() == right.asStr())); }
+
+BinaryKernel binaryKernel(BinaryOp op, Value::Type left, Value::Type right) {
+  if (left != right) return nullptr;
+  switch (left) {
+    case Value::INT:
+      switch (op) {
+        case BinaryOp::ADD: return intAdd;
+        case BinaryOp::SUB: return intSub;
+        case BinaryOp::MUL: return intMul;
+        case BinaryOp::DIV: return intDiv;
+        case BinaryOp::IDIV: return intIdiv;
+        case BinaryOp::MOD: return intMod;
+        case BinaryOp::LT: return intLt;
+        case BinaryOp::GT: return intGt;
+        case BinaryOp::LE: return intLe;
+        case BinaryOp::GE: return intGe;
+        case BinaryOp::EQ: return intEq;
+        case BinaryOp::NE: return intNe;
+      }
+      break;
+    case Value::FLOAT:
+      switch (op) {
+        case BinaryOp::ADD: return floatAdd;
+        case BinaryOp::SUB: return floatSub;
+        case BinaryOp::MUL: return floatMul;
+        case BinaryOp::DIV: return floatDiv;
+        case BinaryOp::LT: return floatLt;
+        case BinaryOp::GT: return floatGt;
+        case BinaryOp::LE: return floatLe;
+        case BinaryOp::GE: return floatGe;
+        default: break;
+      }
+      break;
+    case Value::STR:
+      switch (op) {
+        case BinaryOp::ADD: return strAdd;
+        case BinaryOp::LT: return strLt;
+        case BinaryOp::GT: return strGt;
+        case BinaryOp::LE: return strLe;
+        case BinaryOp::GE: return strGe;
+        case BinaryOp::EQ: return strEq;
+        case BinaryOp::NE: return strNe;
+        default: break;
+      }
+      break;
+    default:
+      break;
+  }
+  return nullptr;
+}
+
+Value unaryPlus(const Value &value) {
+  switch (value.type()) {
+    case Value::FLOAT:
+    case Value::INT: return value;
+    case Value::BOOL: return Value(sjtu::int2048(value.asBool() ? 1 : 0));
+    default: throw std::runtime_error("TypeError: bad operand type for unary +");
+  }
+}
+
+Value unaryMinus(const Value &value) {
+  switch (value.type()) {
+    case Value::FLOAT: return Value(-value.asFloat());
+    case Value::INT: return Value(-value.asInt());
+    case Value::BOOL: return Value(sjtu::int2048(value.asBool() ? -1 : 0));
+    default: throw std::runtime_error("TypeError: bad operand type for unary -");
+  }
+}
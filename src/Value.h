@@ -0,0 +1,100 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_VALUE_H
+#define PYTHON_INTERPRETER_VALUE_H
+
+#include <string>
+#include <variant>
+#include <vector>
+#include <cstdint>
+#include "Cow.h"
+#include "int2048.h"
+
+// This structure does what you think it does.
+struct None {};
+// What reading a name that is bound nowhere gives, as in EvalVisitor: it
+// converts to 0, 0.0, False and "" and prints as nothing.
+struct Undefined {};
+
+class Value;
+using Tuple = std::vector<Value>;
+
+// A runtime value of the compiled engine.
+// UNBOUND marks an empty variable slot and never reaches user code.
+// Ints, strings and tuples live in shared copy-on-write boxes, so copying a
+// Value never copies digits or characters.
+class Value {
+public:
+  enum Type : uint8_t { UNBOUND, NONE, BOOL, INT, FLOAT, STR, TUPLE, UNDEFINED };
+
+  Value() = default;
+  Value(None) : data(None{}) {}
+  Value(Undefined) : data(Undefined{}) {}
+  Value(bool b) : data(b) {}
+  Value(const sjtu::int2048 &i) : data(Cow<sjtu::int2048>(i)) {}
+  Value(sjtu::int2048 &&i) : data(Cow<sjtu::int2048>(std::move(i))) {}
+  Value(double f) : data(f) {}
+  Value(const std::string &s) : data(Cow<std::string>(s)) {}
+  Value(std::string &&s) : data(Cow<std::string>(std::move(s))) {}
+  Value(Tuple &&t) : data(Cow<Tuple>(std::move(t))) {}
+  Value(const char *) = delete;
+
+  Type type() const { return static_cast<Type>(data.index()); }
+  bool isBound() const { return data.index() != UNBOUND; }
+
+  bool asBool() const { return std::get<bool>(data); }
+  const sjtu::int2048 &asInt() const { return std::get<Cow<sjtu::int2048>>(data).get(); }
+  double asFloat() const { return std::get<double>(data); }
+  const std::string &asStr() const { return std::get<Cow<std::string>>(data).get(); }
+  const Tuple &asTuple() const { return std::get<Cow<Tuple>>(data).get(); }
+  // The payload, made private to this Value first if it is shared.
+  sjtu::int2048 &mutableInt() { return std::get<Cow<sjtu::int2048>>(data).mutate(); }
+  std::string &mutableStr() { return std::get<Cow<std::string>>(data).mutate(); }
+  // Update the memory charge of the string after changing it in place.
+  void rechargeStr() { std::get<Cow<std::string>>(data).recharge(); }
+
+private:
+  std::variant<std::monostate, None, bool, Cow<sjtu::int2048>, double, Cow<std::string>, Cow<Tuple>,
+               Undefined>
+      data;
+};
+
+// Binary operators, in the order the compiler and the VM agree on.
+enum class BinaryOp : uint8_t { ADD, SUB, MUL, DIV, IDIV, MOD, LT, GT, LE, GE, EQ, NE };
+
+// The source spelling of an operator, for error messages.
+const char *binaryOpName(BinaryOp op);
+
+// Conversions with the same rules as the tree-walking EvalVisitor.
+sjtu::int2048 toInt(const Value &value);
+double toDouble(const Value &value);
+bool toBool(const Value &value);
+std::string toStr(const Value &value);
+// n! for the int n, with the errors of Python's math.factorial.
+sjtu::int2048 factorialOf(const sjtu::int2048 &n);
+
+// Append the str() form of value to out. Tuples contribute their elements.
+void appendStr(std::string &out, const Value &value);
+
+// Hash and equality for memoization keys. Values are identical only if
+// they have the same type and the same representation, so 1, 1.0 and True
+// are different keys, as are 0.0 and -0.0.
+size_t hashValue(const Value &value);
+bool identical(const Value &left, const Value &right);
+
+// Evaluate left op right. Throws runtime_error for unsupported operand types.
+Value binaryOp(BinaryOp op, const Value &left, const Value &right);
+
+// binaryOp specialized for one pair of operand types: stores left op right
+// into left, reusing its storage where it can.
+using BinaryKernel = void (*)(Value &left, const Value &right);
+
+// The kernel for op on operands of these types, or nullptr if the pair is
+// only handled by the generic binaryOp. A kernel behaves exactly like
+// binaryOp on the types it was chosen for, errors included.
+BinaryKernel binaryKernel(BinaryOp op, Value::Type left, Value::Type right);
+
+// Unary + and -. Throws runtime_error for strings and other non-numbers.
+Value unaryPlus(const Value &value);
+Value unaryMinus(const Value &value);
+
+#endif//PYTHON_INTERPRETER_VALUE_H
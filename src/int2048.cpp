@@ -1,7 +1,99 @@
 #include "int2048.h"
+#include "Memory.h"
+#include "ThreadPool.h"
+#include <algorithm>
 
 namespace sjtu {
 
+std::atomic<unsigned long long> limb_pool::requests{0};
+std::atomic<unsigned long long> limb_pool::reused{0};
+
+namespace {
+struct free_limbs {
+  int *head;
+  int count;
+};
+// This thread's cached buffers; each keeps the next one in its first bytes.
+struct limb_cache {
+  free_limbs lists[limb_pool::MAX_CLASS + 1];
+  size_t bytes;
+  // set once the thread's cache has been drained at thread exit
+  bool closed;
+};
+thread_local limb_cache cache;
+
+// Drains the cache when its thread exits; created on the first buffer a
+// thread caches.
+struct limb_cache_owner {
+  ~limb_cache_owner() {
+    for (auto &list : cache.lists) {
+      while (list.head) {
+        int *next = *reinterpret_cast<int **>(list.head);
+        ::operator delete(list.head);
+        memoryBudget().release(MemoryBudget::BIGNUM, sizeof(int) << (&list - cache.lists));
+        list.head = next;
+      }
+      list.count = 0;
+    }
+    cache.bytes = 0;
+    cache.closed = true;
+  }
+};
+thread_local limb_cache_owner *cache_owner = nullptr;
+
+// the class of a request: the smallest k with 2^k >= n, at least 1 so a
+// buffer can hold the free-list link
+int limb_class(size_t n) {
+  int k = 1;
+  while (((size_t)1 << k) < n) k++;
+  return k;
+}
+} // namespace
+
+int *limb_pool::allocate(size_t n) {
+  int k = limb_class(n);
+  if (int2048::count_allocations) requests.fetch_add(1, std::memory_order_relaxed);
+  // buffers are charged while the pool holds them, cached ones included
+  if (k > MAX_CLASS) {
+    memoryBudget().charge(MemoryBudget::BIGNUM, n * sizeof(int));
+    return static_cast<int *>(::operator new(n * sizeof(int)));
+  }
+  free_limbs &list = cache.lists[k];
+  if (list.head) {
+    int *buffer = list.head;
+    list.head = *reinterpret_cast<int **>(buffer);
+    list.count--;
+    cache.bytes -= sizeof(int) << k;
+    if (int2048::count_allocations) reused.fetch_add(1, std::memory_order_relaxed);
+    return buffer;
+  }
+  memoryBudget().charge(MemoryBudget::BIGNUM, sizeof(int) << k);
+  return static_cast<int *>(::operator new(sizeof(int) << k));
+}
+
+void limb_pool::deallocate(int *p, size_t n) {
+  int k = limb_class(n);
+  size_t bytes = sizeof(int) << k;
+  free_limbs &list = cache.lists[k];
+  if (k > MAX_CLASS || cache.closed || list.count >= KEEP || cache.bytes + bytes > CACHE_BYTES) {
+    ::operator delete(p);
+    memoryBudget().release(MemoryBudget::BIGNUM, k > MAX_CLASS ? n * sizeof(int) : bytes);
+    return;
+  }
+  if (!cache_owner) {
+    static thread_local limb_cache_owner owner;
+    cache_owner = &owner;
+  }
+  *reinterpret_cast<int **>(p) = list.head;
+  list.head = p;
+  list.count++;
+  cache.bytes += bytes;
+}
+
+bool int2048::count_allocations = false;
+std::atomic<unsigned long long> int2048::allocations{0};
+std::atomic<unsigned long long> int2048::limb_histogram[LIMB_BUCKETS] = {};
+
 int2048::int2048() : sign(0) {
   s.clear();
 }
@@ -22,15 +114,23 @@ int2048::int2048(long long num) {
     s.emplace_back(num % BASE);
     num /= BASE;
   }
+  count_allocation();
 }
 
 int2048::int2048(const std::string &num) {
   read(num);
+  count_allocation();
 }
 
 int2048::int2048(const int2048 &num) {
   s = num.s;
   sign = num.sign;
+  count_allocation();
+}
+
+int2048::int2048(int2048 &&num) noexcept : s(std::move(num.s)), sign(num.sign) {
+  num.s.clear();
+  num.sign = 0;
 }
 
 void int2048::read(const std::string &num) {
@@ -84,17 +184,79 @@ void int2048::delete_leading_zeros() {
 }
 
 std::string int2048::to_string() const {
-  if (sign == 0) return "0";
   std::string result;
-  if (sign == -1) result += '-';
-  result += std::to_string(s.back());
-  for (int i = (int)s.size() - 2; i >= 0; --i) {
-    std::string part = std::to_string(s[i]);
-    result += std::string(WIDTH - part.length(), '0') + part;
-  }
+  append_to(result);
   return result;
 }
 
+void int2048::append_to(std::string &out) const {
+  size_t start = out.size();
+  out.resize(start + decimal_size());
+  char *end = write_decimal(&out[start]);
+  out.resize(end - out.data());
+}
+
+// Limbs per parallel range when writing digits.
+static const size_t DIGITS_GRAIN = 1 << 14;
+
+char *int2048::write_decimal(char *out) const {
+  if (sign == 0) {
+    *out++ = '0';
+    return out;
+  }
+  if (sign == -1) *out++ = '-';
+  char buf[WIDTH + 1];
+  int len = snprintf(buf, sizeof(buf), "%d", s.back());
+  memcpy(out, buf, len);
+  out += len;
+  // every lower limb is exactly WIDTH digits, so ranges of them are
+  // independent
+  size_t lower = s.size() - 1;
+  ThreadPool::shared().parallelFor(lower, DIGITS_GRAIN, [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+      int x = s[lower - 1 - k];
+      char *p = out + k * WIDTH;
+      for (int j = WIDTH - 1; j >= 0; --j) {
+        p[j] = '0' + x % 10;
+        x /= 10;
+      }
+    }
+  });
+  return out + lower * WIDTH;
+}
+
+bool int2048::to_small(long long &out) const {
+  if (s.size() > SMALL_LIMBS) return false;
+  long long value = 0;
+  for (int i = (int)s.size() - 1; i >= 0; --i) {
+    value = value * BASE + s[i];
+  }
+  out = sign == -1 ? -value : value;
+  return true;
+}
+
+void int2048::assign_small(long long num) {
+  s.clear();
+  if (num == 0) {
+    sign = 0;
+    return;
+  }
+  sign = num < 0 ? -1 : 1;
+  unsigned long long magnitude = num < 0 ? 0ULL - (unsigned long long)num : (unsigned long long)num;
+  while (magnitude > 0) {
+    s.push_back((int)(magnitude % BASE));
+    magnitude /= BASE;
+  }
+}
+
+size_t int2048::hash() const {
+  size_t h = (size_t)(sign + 1);
+  for (int limb : s) {
+    h = h * 1000003 ^ (size_t)limb;
+  }
+  return h;
+}
+
 double int2048::to_double() const {
   if (sign == 0) return 0.0;
   double result = 0.0;
@@ -210,6 +372,14 @@ int2048 &int2048::operator=(const int2048 &b) {
   return *this;
 }
 
+int2048 &int2048::operator=(int2048 &&b) noexcept {
+  s.swap(b.s);
+  sign = b.sign;
+  b.s.clear();
+  b.sign = 0;
+  return *this;
+}
+
 int2048 &int2048::operator+=(const int2048 &b) {
   *this = sjtu::add(*this, b);
   return *this;
@@ -228,26 +398,98 @@ int2048 operator-(int2048 a, const int2048 &b) {
   return sjtu::minus(a, b);
 }
 
-void FFT(std::vector<std::complex<long double>> &a, bool invert) {
-  int n = a.size();
-  if (n == 1) return;
+// Butterflies per parallel range, enough to outweigh handing it to a thread.
+static const size_t PARALLEL_GRAIN = 1 << 12;
 
-  std::vector<std::complex<long double>> a0(n >> 1), a1(n >> 1);
-  for (int i = 0; 2 * i < n; ++i) {
-    a0[i] = a[2 * i];
-    a1[i] = a[2 * i + 1];
-  }
+static size_t reverse_bits(size_t x, int bits) {
+  size_t r = 0;
+  for (int i = 0; i < bits; ++i, x >>= 1) r = (r << 1) | (x & 1);
+  return r;
+}
 
-  FFT(a0, invert);
-  FFT(a1, invert);
+// In-place iterative transform of every array in arrays, each of size n (a
+// power of two); the inverse is left unscaled. Each level's butterflies, of
+// all the arrays together, are split into ranges of at least grain for the
+// shared thread pool, so a large enough grain keeps everything serial.
+static void transform(std::complex<long double> *const *arrays, size_t count, size_t n, bool invert, size_t grain) {
+  if (n <= 1) return;
+  ThreadPool &pool = ThreadPool::shared();
+  int bits = 0;
+  while (((size_t)1 << bits) < n) bits++;
+
+  pool.parallelFor(count * n, grain, [&](size_t begin, size_t end) {
+    for (size_t t = begin; t < end; ++t) {
+      size_t i = t % n, j = reverse_bits(i, bits);
+      if (i < j) std::swap(arrays[t / n][i], arrays[t / n][j]);
+    }
+  });
 
+  // roots[k] = e^(-+2 pi i k / n); each block of ROOT_BLOCK starts from an
+  // exact value, so the error of the repeated products stays small
+  const size_t ROOT_BLOCK = 64;
+  size_t half_n = n >> 1;
+  std::vector<std::complex<long double>> roots(half_n);
   long double angle = 2 * int2048::PI / n * (invert ? 1 : -1);
-  std::complex<long double> omega(1), delta(cosl(angle), sinl(angle));
+  std::complex<long double> delta(cosl(angle), sinl(angle));
+  pool.parallelFor((half_n + ROOT_BLOCK - 1) / ROOT_BLOCK, grain / ROOT_BLOCK, [&](size_t begin, size_t end) {
+    for (size_t block = begin; block < end; ++block) {
+      size_t k = block * ROOT_BLOCK, stop = std::min(half_n, k + ROOT_BLOCK);
+      std::complex<long double> omega(cosl(angle * k), sinl(angle * k));
+      for (; k < stop; ++k, omega *= delta) roots[k] = omega;
+    }
+  });
+
+  for (size_t len = 2; len <= n; len <<= 1) {
+    size_t half = len >> 1, step = n / len;
+    pool.parallelFor(count * half_n, grain, [&](size_t begin, size_t end) {
+      for (size_t t = begin; t < end;) {
+        // butterfly t is butterfly j of group `group` in array t / half_n
+        size_t k = t % half_n, group = k / half, j = k % half;
+        std::complex<long double> *a = arrays[t / half_n] + group * len;
+        size_t stop = std::min(end - t, half - j);
+        for (size_t x = 0; x < stop; ++x, ++j) {
+          std::complex<long double> u = a[j], v = a[j + half] * roots[j * step];
+          a[j] = u + v;
+          a[j + half] = u - v;
+        }
+        t += stop;
+      }
+    });
+  }
+}
 
-  for (int i = 0; 2 * i < n; ++i) {
-    a[i] = a0[i] + omega * a1[i];
-    a[i + n / 2] = a0[i] - omega * a1[i];
-    omega *= delta;
+static size_t transform_grain(size_t n) {
+  return n >= (size_t)int2048::PARALLEL_FFT ? PARALLEL_GRAIN : (size_t)-1;
+}
+
+void FFT(std::vector<std::complex<long double>> &a, bool invert) {
+  std::complex<long double> *data = a.data();
+  transform(&data, 1, a.size(), invert, transform_grain(a.size()));
+}
+
+// Charges temporary buffers to the memory budget for as long as it lives.
+struct scratch_charge {
+  size_t bytes;
+  explicit scratch_charge(size_t bytes) : bytes(bytes) { memoryBudget().charge(MemoryBudget::BIGNUM, bytes); }
+  ~scratch_charge() { memoryBudget().release(MemoryBudget::BIGNUM, bytes); }
+};
+
+// O(n * m) product for when one side has at most SCHOOLBOOK_LIMBS limbs,
+// which is cheaper than three transforms of the combined size.
+static void schoolbook_multiply(const int2048::limbs &small, const int2048::limbs &large, int2048::limbs &out) {
+  std::vector<long long> sum(small.size() + large.size());
+  for (size_t i = 0; i < small.size(); ++i) {
+    long long x = small[i];
+    if (x == 0) continue;
+    long long *row = sum.data() + i;
+    for (size_t j = 0; j < large.size(); ++j) row[j] += x * large[j];
+  }
+  out.resize(sum.size());
+  long long carry = 0;
+  for (size_t i = 0; i < sum.size(); ++i) {
+    long long x = sum[i] + carry;
+    out[i] = x % int2048::BASE;
+    carry = x / int2048::BASE;
   }
 }
 
@@ -257,26 +499,49 @@ int2048 operator*(int2048 a, const int2048 &b) {
   int2048 result;
   result.sign = a.sign * b.sign;
 
+  if (std::min(a.s.size(), b.s.size()) <= (size_t)int2048::SCHOOLBOOK_LIMBS) {
+    if (a.s.size() <= b.s.size()) {
+      schoolbook_multiply(a.s, b.s, result.s);
+    } else {
+      schoolbook_multiply(b.s, a.s, result.s);
+    }
+    result.delete_leading_zeros();
+    return result;
+  }
+
   size_t len = 1;
   while (len < a.s.size() + b.s.size()) len <<= 1;
+  size_t grain = transform_grain(len);
+  // the transforms and the rounded digits below
+  scratch_charge scratch(len * (2 * sizeof(std::complex<long double>) + sizeof(long long)));
+  ThreadPool &pool = ThreadPool::shared();
 
   std::vector<std::complex<long double>> fft_a(a.s.begin(), a.s.end());
   std::vector<std::complex<long double>> fft_b(b.s.begin(), b.s.end());
   fft_a.resize(len);
   fft_b.resize(len);
 
-  FFT(fft_a, false);
-  FFT(fft_b, false);
+  // both forward transforms share each level's parallel loop
+  std::complex<long double> *forward[2] = {fft_a.data(), fft_b.data()};
+  transform(forward, 2, len, false, grain);
 
-  for (size_t i = 0; i < len; ++i) fft_a[i] *= fft_b[i];
+  pool.parallelFor(len, grain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) fft_a[i] *= fft_b[i];
+  });
 
-  FFT(fft_a, true);
+  std::complex<long double> *inverse = fft_a.data();
+  transform(&inverse, 1, len, true, grain);
+
+  std::vector<long long> digits(len);
+  pool.parallelFor(len, grain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) digits[i] = (long long)(fft_a[i].real() / len + 0.5);
+  });
 
   result.s.resize(len);
   long long carry = 0;
 
   for (size_t i = 0; i < len; ++i) {
-    long long x = (long long)(fft_a[i].real() / len + 0.5) + carry;
+    long long x = digits[i] + carry;
     result.s[i] = x % int2048::BASE;
     carry = x / int2048::BASE;
   }
@@ -504,4 +769,45 @@ bool operator>=(const int2048 &a, const int2048 &b) {
   return !(a < b);
 }
 
+static int2048 product_serial(const int2048 *begin, const int2048 *end) {
+  size_t n = end - begin;
+  if (n == 0) return int2048(1);
+  if (n == 1) return *begin;
+  const int2048 *mid = begin + n / 2;
+  return product_serial(begin, mid) * product_serial(mid, end);
+}
+
+int2048 product(const int2048 *begin, const int2048 *end) {
+  ThreadPool &pool = ThreadPool::shared();
+  size_t n = end - begin;
+  // one subtree per thread; the multiplies joining them are large enough
+  // to parallelise inside themselves
+  size_t parts = std::min(n / 2, pool.threads());
+  if (parts <= 1) return product_serial(begin, end);
+  std::vector<int2048> partial(parts);
+  pool.parallelFor(parts, 1, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+      partial[i] = product_serial(begin + n * i / parts, begin + n * (i + 1) / parts);
+    }
+  });
+  return product_serial(partial.data(), partial.data() + parts);
+}
+
+int2048 factorial(long long n) {
+  // pack runs of factors into leaves below LEAF_LIMIT, so the tree starts
+  // from a few limbs per leaf instead of one multiply per factor
+  const long long LEAF_LIMIT = 1LL << 40;
+  std::vector<int2048> leaves;
+  long long leaf = 1;
+  for (long long k = 2; k <= n; ++k) {
+    if (leaf > LEAF_LIMIT / k) {
+      leaves.emplace_back(leaf);
+      leaf = 1;
+    }
+    leaf *= k;
+  }
+  leaves.emplace_back(leaf);
+  return product(leaves.data(), leaves.data() + leaves.size());
+}
+
 } // namespace sjtu
@@ -2,6 +2,7 @@
 #ifndef SJTU_BIGINTEGER
 #define SJTU_BIGINTEGER
 
+#include <atomic>
 #include <complex>
 #include <cstdio>
 #include <cstring>
@@ -9,13 +10,50 @@
 #include <vector>
 
 namespace sjtu {
+// Limb buffers recycled by capacity class: a request for n limbs gets a
+// buffer of the next power of two, and a freed buffer goes on a per-thread
+// list for its class, up to KEEP buffers and CACHE_BYTES in all, to serve
+// the next request of that class. Buffers above MAX_CLASS go straight to
+// the heap.
+struct limb_pool {
+  const static int MAX_CLASS = 16;
+  const static int KEEP = 16;
+  const static size_t CACHE_BYTES = 1 << 20;
+  static int *allocate(size_t n);
+  static void deallocate(int *p, size_t n);
+  // requests, and how many of them a cached buffer served; counted while
+  // int2048::count_allocations is set
+  static std::atomic<unsigned long long> requests;
+  static std::atomic<unsigned long long> reused;
+};
+
+template <typename T>
+struct limb_allocator {
+  static_assert(sizeof(T) == sizeof(int), "limb_allocator is for limbs");
+  using value_type = T;
+  limb_allocator() = default;
+  template <typename U>
+  limb_allocator(const limb_allocator<U> &) {}
+  T *allocate(size_t n) { return reinterpret_cast<T *>(limb_pool::allocate(n)); }
+  void deallocate(T *p, size_t n) { limb_pool::deallocate(reinterpret_cast<int *>(p), n); }
+  template <typename U>
+  bool operator==(const limb_allocator<U> &) const { return true; }
+  template <typename U>
+  bool operator!=(const limb_allocator<U> &) const { return false; }
+};
+
 class int2048 {
 public:
   const static int BASE = 10000;
   const static int WIDTH = 4;
   constexpr static long double PI = 3.141592653589793238462643383279502884L;
+  // Products with a side of at most SCHOOLBOOK_LIMBS limbs skip the FFT;
+  // transforms of at least PARALLEL_FFT points use the shared ThreadPool.
+  const static int SCHOOLBOOK_LIMBS = 32;
+  const static int PARALLEL_FFT = 1 << 14;
 
-  std::vector<int> s;
+  using limbs = std::vector<int, limb_allocator<int>>;
+  limbs s;
   int sign;
 
   // constructors
@@ -23,12 +61,43 @@ public:
   int2048(long long);
   int2048(const std::string &);
   int2048(const int2048 &);
+  // Moves take the limbs and leave zero behind; they allocate nothing, so
+  // count_allocation() is not called.
+  int2048(int2048 &&) noexcept;
 
   void read(const std::string &);
   void print();
   void delete_leading_zeros();
   std::string to_string() const;
+  void append_to(std::string &) const;
+  // Write the decimal digits, and a '-' if negative, to out, which has room
+  // for decimal_size() characters; returns the end of what was written.
+  size_t decimal_size() const { return s.size() * WIDTH + 1; }
+  char *write_decimal(char *out) const;
   double to_double() const;
+  // If the value has at most SMALL_LIMBS limbs, store it in out and return true.
+  const static int SMALL_LIMBS = 4;
+  bool to_small(long long &out) const;
+  // Set the value from a long long, reusing the limb storage.
+  void assign_small(long long);
+  // Equal values have equal hashes.
+  size_t hash() const;
+
+  // Allocation statistics, collected while count_allocations is set: the
+  // number of constructions that allocated limbs, and how many of them had
+  // at most 1, 2, 4, 8, ... limbs (the last bucket takes all larger ones).
+  // Atomic, as product() constructs values on the ThreadPool.
+  const static int LIMB_BUCKETS = 24;
+  static bool count_allocations;
+  static std::atomic<unsigned long long> allocations;
+  static std::atomic<unsigned long long> limb_histogram[LIMB_BUCKETS];
+  void count_allocation() const {
+    if (!count_allocations || s.empty()) return;
+    int bucket = 0;
+    while (bucket + 1 < LIMB_BUCKETS && ((size_t)1 << bucket) < s.size()) bucket++;
+    allocations++;
+    limb_histogram[bucket]++;
+  }
 
   int2048 &add(const int2048 &);
   int2048 &minus(const int2048 &);
@@ -36,6 +105,7 @@ public:
   int2048 operator+() const;
   int2048 operator-() const;
   int2048 &operator=(const int2048 &);
+  int2048 &operator=(int2048 &&) noexcept;
 
   int2048 &operator+=(const int2048 &);
   int2048 &operator-=(const int2048 &);
@@ -73,6 +143,11 @@ int2048 shift_left(const int2048 &, size_t);
 int2048 mul_short(const int2048 &, int);
 std::pair<int2048, int2048> basic_divide(const int2048 &, const int2048 &);
 std::pair<int2048, int2048> divide(const int2048 &, const int2048 &);
+// The product of [begin, end), multiplied as a balanced tree so the large
+// multiplies come last; the lower subtrees run on the ThreadPool.
+int2048 product(const int2048 *, const int2048 *);
+// n! for n >= 0, by product().
+int2048 factorial(long long);
 
 } // namespace sjtu
 
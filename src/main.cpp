@@ -1,20 +1,381 @@
+#include "AstBuilder.h"
+#include "Compiler.h"
+#include "ConstantFolder.h"
 #include "Evalvisitor.h"
+#include "FloatFormat.h"
+#include "Memory.h"
+#include "Output.h"
+#include "Profiler.h"
+#include "ScriptCache.h"
+#include "ScriptParser.h"
+#include "SourceInput.h"
+#include "Stats.h"
+#include "ThreadPool.h"
+#include "VM.h"
 #include "Python3Lexer.h"
 #include "Python3Parser.h"
 #include "antlr4-runtime.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 using namespace antlr4;
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Set by --profile; its reports are written when the process exits, which
+// for a script that fails is from the exit(1) after the error message.
+static std::unique_ptr<Profiler> profiler;
+static std::string profilePrefix;
+
+static void writeProfile() {
+	if (!profiler) return;
+	profiler->stop();
+	std::ofstream report(profilePrefix + ".txt");
+	profiler->writeReport(report);
+	std::ofstream collapsed(profilePrefix + ".folded");
+	profiler->writeCollapsed(collapsed);
+	if (!report || !collapsed) {
+		std::cerr << "cannot write the profile to " << profilePrefix << ".txt and " << profilePrefix << ".folded" << std::endl;
+	}
+}
+
+static void startProfile(const SourceFile &source) {
+	profiler = std::make_unique<Profiler>(std::string(source.data(), source.size()));
+	atexit(writeProfile);
+	profiler->start();
+}
+
+// Set by --stats or PYTHON_INTERPRETER_STATS: where to write the counters
+// as JSON when the process exits; "-" is stderr.
+static std::string statsPath;
+
+// Set by --max-memory; the peak memory report goes to stderr at exit.
+static void writeMemoryReport() {
+	memoryBudget().writeReport(std::cerr);
+}
+
+// BYTES with an optional K, M or G (binary) suffix, or 0 if malformed.
+static size_t parseSize(const char *text) {
+	char *end;
+	unsigned long long value = strtoull(text, &end, 10);
+	if (end == text) return 0;
+	switch (*end) {
+		case '\0': return value;
+		case 'k': case 'K': value <<= 10; break;
+		case 'm': case 'M': value <<= 20; break;
+		case 'g': case 'G': value <<= 30; break;
+		default: return 0;
+	}
+	return end[1] == '\0' ? value : 0;
+}
+
+static void writeStats() {
+	if (statsPath == "-") {
+		stats().writeJson(std::cerr);
+		return;
+	}
+	std::ofstream file(statsPath);
+	stats().writeJson(file);
+	if (!file) {
+		std::cerr << "cannot write the statistics to " << statsPath << std::endl;
+	}
+}
+
+static void usage(const char *prog) {
+	std::cerr << "usage: " << prog << " [--engine=vm|tree] [--frontend=native|antlr|check] [--cache-dir=DIR] [--flush=line|block] [--output-buffer=BYTES] [--float-format=fixed|repr] [--recursion-limit=N] [--threads=N] [--max-memory=BYTES[K|M|G]] [--memoize] [--profile[=PREFIX]] [--stats[=FILE]] [--timing] [script.py]" << std::endl;
+	exit(2);
+}
+
+// Run the ANTLR parser over the whole file.
+// Stage 1 uses SLL prediction and bails out on the first syntax error; this
+// is exact for almost every input and much cheaper than full LL. If it fails,
+// the input either has a real syntax error or needs full context, so stage 2
+// rewinds and parses again in LL mode with normal error reporting.
+static Python3Parser::File_inputContext *parse(Python3Parser &parser, CommonTokenStream &tokens, bool timing) {
+	auto stageStart = Clock::now();
+	parser.getInterpreter<atn::ParserATNSimulator>()->setPredictionMode(atn::PredictionMode::SLL);
+	parser.removeErrorListeners();
+	parser.setErrorHandler(std::make_shared<BailErrorStrategy>());
+	Python3Parser::File_inputContext *tree = nullptr;
+	try {
+		tree = parser.file_input();
+	} catch (const ParseCancellationException &) {
+		tree = nullptr;
+	}
+	if (timing) {
+		std::cerr << "[timing] parse (SLL): " << secondsSince(stageStart) << "s" << (tree ? "" : ", failed") << std::endl;
+	}
+	if (!tree) {
+		stageStart = Clock::now();
+		tokens.seek(0);
+		parser.reset();
+		parser.addErrorListener(&ConsoleErrorListener::INSTANCE);
+		parser.setErrorHandler(std::make_shared<DefaultErrorStrategy>());
+		parser.getInterpreter<atn::ParserATNSimulator>()->setPredictionMode(atn::PredictionMode::LL);
+		tree = parser.file_input();
+		if (timing) {
+			std::cerr << "[timing] parse (LL): " << secondsSince(stageStart) << "s" << std::endl;
+		}
+	}
+	return tree;
+}
+
+// Execute a parse tree with the tree-walking EvalVisitor.
+static void runTree(Python3Parser::File_inputContext *tree) {
+	EvalVisitor visitor;
+	visitor.setProfiler(profiler.get());
+	visitor.visit(tree);
+	output().flush();
+}
+
+enum class Frontend { NATIVE, ANTLR, CHECK };
+
+// Build the AST through ANTLR and AstBuilder. A script with syntax errors
+// never gets this far: ANTLR reports them, and EvalVisitor runs whatever
+// its error recovery produced, as it always has. With nativeAccepted set
+// (cross-checking), such a script is a disagreement between the front ends.
+static std::unique_ptr<ast::Program> parseWithAntlr(const SourceFile &source, bool timing, bool nativeAccepted = false) {
+	auto input = source.makeCharStream();
+	Python3Lexer lexer(input.get());
+	// tokens are pulled from the lexer as the parser asks for them
+	CommonTokenStream tokens(&lexer);
+	Python3Parser parser(&tokens);
+	auto tree = parse(parser, tokens, timing);
+	if (parser.getNumberOfSyntaxErrors() > 0) {
+		if (nativeAccepted) {
+			std::cerr << "[check] the native front end accepted a script with syntax errors" << std::endl;
+			exit(3);
+		}
+		// error recovery leaves holes in the tree that only EvalVisitor
+		// copes with, so such scripts keep running the old way
+		runTree(tree);
+		exit(0);
+	}
+	try {
+		return AstBuilder().build(tree);
+	} catch (const std::runtime_error &e) {
+		std::cerr << "Runtime Error: " << e.what() << std::endl;
+		exit(1);
+	}
+}
+
+// Build the AST with the hand-written Tokenizer and ScriptParser, or
+// return nullptr (and the reason in error) if they do not accept the script.
+static std::unique_ptr<ast::Program> parseNative(const SourceFile &source, bool timing, std::string &error) {
+	auto stageStart = Clock::now();
+	std::unique_ptr<ast::Program> program;
+	try {
+		program = ScriptParser(source.data(), source.size()).parse();
+	} catch (const std::exception &e) {
+		error = e.what();
+	}
+	if (timing) {
+		std::cerr << "[timing] parse (native): " << secondsSince(stageStart) << "s" << (program ? "" : ", failed") << std::endl;
+	}
+	return program;
+}
+
+// Compare the trees of both front ends and exit with status 3 if they differ.
+static void crossCheck(const ast::Program *native, const std::string &error, const ast::Program &reference) {
+	if (!native) {
+		std::cerr << "[check] the native front end rejected the script: " << error << std::endl;
+		exit(3);
+	}
+	std::string mine = ast::dump(*native), theirs = ast::dump(reference);
+	if (mine == theirs) return;
+	size_t at = 0;
+	while (at < mine.size() && at < theirs.size() && mine[at] == theirs[at]) at++;
+	size_t lineStart = mine.rfind('\n', at == 0 ? 0 : at - 1);
+	lineStart = lineStart == std::string::npos || at == 0 ? 0 : lineStart + 1;
+	std::cerr << "[check] the front ends disagree" << std::endl;
+	std::cerr << "  native: " << mine.substr(lineStart, mine.find('\n', lineStart) - lineStart) << std::endl;
+	std::cerr << "  antlr:  " << theirs.substr(lineStart, theirs.find('\n', lineStart) - lineStart) << std::endl;
+	exit(3);
+}
+
+// Parse, lower and compile the source into a Module.
+static std::unique_ptr<Module> compileSource(const SourceFile &source, Frontend frontend, bool timing) {
+	std::unique_ptr<ast::Program> program;
+	if (frontend != Frontend::ANTLR) {
+		std::string error;
+		program = parseNative(source, timing, error);
+		if (frontend == Frontend::CHECK) {
+			auto reference = parseWithAntlr(source, timing, program != nullptr);
+			crossCheck(program.get(), error, *reference);
+		}
+	}
+	if (!program) {
+		program = parseWithAntlr(source, timing);
+	}
+
+	auto stageStart = Clock::now();
+	std::unique_ptr<Module> module;
+	try {
+		ConstantFolder().fold(*program);
+		module = Compiler().compile(*program);
+	} catch (const std::runtime_error &e) {
+		std::cerr << "Runtime Error: " << e.what() << std::endl;
+		exit(1);
+	}
+	if (timing) {
+		std::cerr << "[timing] compile: " << secondsSince(stageStart) << "s, ast " << program->bytesUsed() << " bytes" << std::endl;
+	}
+	return module;
+}
+
 // TODO: regenerating files in directory named "generated" is dangerous.
 //       if you really need to regenerate,please ask TA for help.
 int main(int argc, const char *argv[]) {
-	// TODO: please don't modify the code below the construction of ifs if you want to use visitor mode
-	ANTLRInputStream input(std::cin);
-	Python3Lexer lexer(&input);
-	CommonTokenStream tokens(&lexer);
-	tokens.fill();
-	Python3Parser parser(&tokens);
-	tree::ParseTree *tree = parser.file_input();
-	EvalVisitor visitor;
-	visitor.visit(tree);
+	const char *path = nullptr;
+	bool timing = false;
+	bool treeEngine = false;
+	Frontend frontend = Frontend::NATIVE;
+	std::string cacheDir = ScriptCache::defaultDirectory();
+	size_t recursionLimit = VM::DEFAULT_RECURSION_LIMIT;
+	bool recursionLimitSet = false;
+	bool memoize = false;
+	if (const char *env = getenv("PYTHON_INTERPRETER_STATS")) statsPath = env;
+	for (int i = 1; i < argc; ++i) {
+		const char *arg = argv[i];
+		if (strcmp(arg, "--engine=vm") == 0) {
+			treeEngine = false;
+		} else if (strcmp(arg, "--engine=tree") == 0) {
+			treeEngine = true;
+		} else if (strcmp(arg, "--frontend=native") == 0) {
+			frontend = Frontend::NATIVE;
+		} else if (strcmp(arg, "--frontend=antlr") == 0) {
+			frontend = Frontend::ANTLR;
+		} else if (strcmp(arg, "--frontend=check") == 0) {
+			frontend = Frontend::CHECK;
+		} else if (strncmp(arg, "--cache-dir=", 12) == 0) {
+			cacheDir = arg + 12;
+		} else if (strcmp(arg, "--flush=line") == 0) {
+			output().setPolicy(Output::LINE);
+		} else if (strcmp(arg, "--flush=block") == 0) {
+			output().setPolicy(Output::BLOCK);
+		} else if (strncmp(arg, "--output-buffer=", 16) == 0) {
+			long long bytes = atoll(arg + 16);
+			if (bytes <= 0) usage(argv[0]);
+			output().setCapacity(bytes);
+		} else if (strcmp(arg, "--float-format=fixed") == 0) {
+			setFloatStyle(FloatStyle::FIXED);
+		} else if (strcmp(arg, "--float-format=repr") == 0) {
+			setFloatStyle(FloatStyle::REPR);
+		} else if (strncmp(arg, "--recursion-limit=", 18) == 0) {
+			long long limit = atoll(arg + 18);
+			if (limit <= 0) usage(argv[0]);
+			recursionLimit = limit;
+			recursionLimitSet = true;
+		} else if (strncmp(arg, "--threads=", 10) == 0) {
+			long long threads = atoll(arg + 10);
+			if (threads <= 0) usage(argv[0]);
+			ThreadPool::shared().setThreads(threads);
+		} else if (strncmp(arg, "--max-memory=", 13) == 0) {
+			size_t limit = parseSize(arg + 13);
+			if (limit == 0) usage(argv[0]);
+			memoryBudget().setLimit(limit);
+		} else if (strcmp(arg, "--memoize") == 0) {
+			memoize = true;
+		} else if (strcmp(arg, "--profile") == 0) {
+			profilePrefix = "profile";
+		} else if (strncmp(arg, "--profile=", 10) == 0) {
+			profilePrefix = arg + 10;
+			if (profilePrefix.empty()) usage(argv[0]);
+		} else if (strcmp(arg, "--stats") == 0) {
+			statsPath = "-";
+		} else if (strncmp(arg, "--stats=", 8) == 0) {
+			statsPath = arg + 8;
+			if (statsPath.empty()) usage(argv[0]);
+		} else if (strcmp(arg, "--timing") == 0) {
+			timing = true;
+		} else if (arg[0] != '-' && !path) {
+			path = arg;
+		} else {
+			usage(argv[0]);
+		}
+	}
+	// EvalVisitor recurses on the native stack and has no memo tables, so
+	// these options would be silently ignored
+	if (treeEngine && (memoize || recursionLimitSet)) {
+		std::cerr << argv[0] << ": --memoize and --recursion-limit need --engine=vm" << std::endl;
+		return 2;
+	}
+	if (!statsPath.empty()) {
+		stats().enable();
+		memoryBudget().enable();
+		// writeStats reads output()'s byte count; constructing it first
+		// makes it outlive the handler, which exit runs before destroying it
+		output();
+		atexit(writeStats);
+	}
+	if (memoryBudget().getLimit()) {
+		memoryBudget().enable();
+		atexit(writeMemoryReport);
+	}
+	auto start = Clock::now();
+	std::unique_ptr<SourceFile> source;
+	try {
+		source = path ? SourceFile::open(path) : SourceFile::fromDescriptor(0);
+	} catch (const std::runtime_error &e) {
+		std::cerr << e.what() << std::endl;
+		return 2;
+	}
+
+	if (treeEngine) {
+		// the original tree-walking interpreter, kept as the reference
+		// TODO: please don't modify the code below the construction of ifs if you want to use visitor mode
+		auto input = source->makeCharStream();
+		Python3Lexer lexer(input.get());
+		CommonTokenStream tokens(&lexer);
+		Python3Parser parser(&tokens);
+		auto tree = parse(parser, tokens, timing);
+		auto stageStart = Clock::now();
+		if (!profilePrefix.empty()) startProfile(*source);
+		runTree(tree);
+		if (timing) {
+			std::cerr << "[timing] execute: " << secondsSince(stageStart) << "s" << std::endl;
+			std::cerr << "[timing] total: " << secondsSince(start) << "s" << std::endl;
+		}
+		return 0;
+	}
+
+	std::unique_ptr<Module> module;
+	if (!cacheDir.empty() && frontend != Frontend::CHECK) {
+		auto stageStart = Clock::now();
+		module = ScriptCache(cacheDir).load(source->data(), source->size());
+		if (timing) {
+			std::cerr << "[timing] cache lookup: " << secondsSince(stageStart) << "s" << (module ? ", hit" : ", miss") << std::endl;
+		}
+	}
+	if (!module) {
+		module = compileSource(*source, frontend, timing);
+		if (!cacheDir.empty()) {
+			auto stageStart = Clock::now();
+			ScriptCache(cacheDir).store(source->data(), source->size(), *module);
+			if (timing) {
+				std::cerr << "[timing] cache store: " << secondsSince(stageStart) << "s" << std::endl;
+			}
+		}
+	}
+
+	auto stageStart = Clock::now();
+	VM vm(*module);
+	vm.setRecursionLimit(recursionLimit);
+	vm.setMemoize(memoize);
+	if (!profilePrefix.empty()) {
+		startProfile(*source);
+		vm.setProfiler(profiler.get());
+	}
+	vm.run();
+	output().flush();
+	if (timing) {
+		std::cerr << "[timing] execute: " << secondsSince(stageStart) << "s" << std::endl;
+		std::cerr << "[timing] total: " << secondsSince(start) << "s" << std::endl;
+	}
 	return 0;
 }
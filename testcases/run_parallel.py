@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+"""Run the testcases through the interpreter on all cores.
+
+Each case is a .in (or .py) script; if a .out file sits next to it, the
+interpreter's output must match it, otherwise only a clean exit counts. A
+.args file next to it holds extra interpreter arguments for that case; a
+.err file is the expected stderr and a .status file the expected exit
+status, for cases that end in an error.
+
+Scheduling is longest-first: cases are ordered by the duration recorded in
+--durations on earlier runs (unknown cases first, as they may be long) and
+dealt out to one deque per worker. A worker takes cases from the front of
+its own deque and, once that is empty, steals from the back of the fullest
+other one, so the suite finishes close to the time of its slowest case.
+
+Every case runs with a timeout and an address-space limit. The report
+lists failures and the slowest cases, then the totals; the exit status is
+1 if any case failed.
+Usually run through the build: cmake --build build --target check
+"""
+import argparse
+import collections
+import json
+import os
+import resource
+import subprocess
+import sys
+import threading
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+MEMORY_ERRORS = (b"bad_alloc", b"MemoryError", b"failed to map segment", b"Cannot allocate memory")
+
+
+class Case:
+    def __init__(self, script):
+        self.script = script
+        self.name = os.path.relpath(script, HERE)
+        base = os.path.splitext(script)[0]
+        self.expected = base + ".out" if os.path.exists(base + ".out") else None
+        self.expected_stderr = base + ".err" if os.path.exists(base + ".err") else None
+        self.expected_status = None
+        if os.path.exists(base + ".status"):
+            with open(base + ".status") as f:
+                self.expected_status = int(f.read())
+        self.args = []
+        if os.path.exists(base + ".args"):
+            with open(base + ".args") as f:
+                self.args = f.read().split()
+        self.status = None
+        self.seconds = 0.0
+        self.detail = ""
+
+
+def find_cases(directories):
+    cases = []
+    for directory in directories:
+        for root, _, files in os.walk(directory):
+            for name in sorted(files):
+                if name.endswith(".in") or (name.endswith(".py") and root != HERE):
+                    cases.append(Case(os.path.join(root, name)))
+    return cases
+
+
+class WorkPool:
+    """Per-worker deques; idle workers steal from the back of the fullest."""
+
+    def __init__(self, cases, workers):
+        self.queues = [collections.deque() for _ in range(workers)]
+        for i, case in enumerate(cases):
+            self.queues[i % workers].append(case)
+        self.lock = threading.Lock()
+
+    def take(self, worker):
+        with self.lock:
+            if self.queues[worker]:
+                return self.queues[worker].popleft()
+            victim = max(self.queues, key=len)
+            return victim.pop() if victim else None
+
+
+def limit_memory(megabytes):
+    def apply():
+        limit = megabytes * 1024 * 1024
+        resource.setrlimit(resource.RLIMIT_AS, (limit, limit))
+    return apply
+
+
+def run_case(args, case):
+    start = time.perf_counter()
+    try:
+        with open(case.script, "rb") as stdin:
+            result = subprocess.run([args.interpreter] + args.interpreter_arg + case.args, stdin=stdin,
+                                    stdout=subprocess.PIPE, stderr=subprocess.PIPE, timeout=args.timeout,
+                                    preexec_fn=limit_memory(args.memory) if args.memory else None)
+    except subprocess.TimeoutExpired:
+        case.seconds = time.perf_counter() - start
+        case.status, case.detail = "TIMEOUT", "killed after %ds" % args.timeout
+        return
+    case.seconds = time.perf_counter() - start
+    if result.returncode < 0:
+        case.status, case.detail = "CRASH", "signal %d" % -result.returncode
+    elif case.expected_status is not None and result.returncode != case.expected_status:
+        case.status = "FAIL"
+        case.detail = "exit status %d, expected %d" % (result.returncode, case.expected_status)
+    elif case.expected:
+        with open(case.expected, "rb") as f:
+            matched = f.read() == result.stdout
+        case.status = "PASS" if matched else "FAIL"
+        if not matched:
+            case.detail = "output differs from %s" % os.path.relpath(case.expected, HERE)
+    elif result.returncode == 0 or case.expected_status is not None:
+        case.status = "PASS"
+    else:
+        case.status = "FAIL"
+        case.detail = "exit status %d: %s" % (result.returncode, result.stderr.decode(errors="replace").strip()[-200:])
+    if case.status == "PASS" and case.expected_stderr:
+        with open(case.expected_stderr, "rb") as f:
+            if f.read() != result.stderr:
+                case.status = "FAIL"
+                case.detail = "stderr differs from %s" % os.path.relpath(case.expected_stderr, HERE)
+    # running out of the address-space limit shows up as a failed allocation,
+    # or as the loader failing to map the binary at all
+    if case.status != "PASS" and args.memory and any(marker in result.stderr for marker in MEMORY_ERRORS):
+        case.status, case.detail = "MEMORY", "exceeded %d MiB" % args.memory
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--interpreter", required=True, help="the code executable")
+    parser.add_argument("--interpreter-arg", action="append", default=[],
+                        help="extra argument for the interpreter (repeatable)")
+    parser.add_argument("--cases", action="append",
+                        help="directory searched for .in/.py cases (repeatable; default: this directory)")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count() or 1, help="parallel workers")
+    parser.add_argument("--timeout", type=int, default=60, help="seconds per case (default 60)")
+    parser.add_argument("--memory", type=int, default=2048, help="MiB of address space per case, 0 for no limit")
+    parser.add_argument("--durations", help="JSON file of recorded case durations, read and updated")
+    parser.add_argument("--json", help="also write the report as JSON here")
+    args = parser.parse_args()
+
+    cases = find_cases(args.cases or [HERE])
+    recorded = {}
+    if args.durations and os.path.exists(args.durations):
+        with open(args.durations) as f:
+            recorded = json.load(f)
+    cases.sort(key=lambda case: -recorded.get(case.name, float("inf")))
+
+    workers = max(1, min(args.jobs, len(cases)))
+    pool = WorkPool(cases, workers)
+
+    def work(worker):
+        while True:
+            case = pool.take(worker)
+            if case is None:
+                return
+            run_case(args, case)
+
+    start = time.perf_counter()
+    threads = [threading.Thread(target=work, args=(i,)) for i in range(workers)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    elapsed = time.perf_counter() - start
+
+    failed = [case for case in cases if case.status != "PASS"]
+    for case in sorted(failed, key=lambda case: case.name):
+        print("%-8s %-45s %8.3fs  %s" % (case.status, case.name, case.seconds, case.detail))
+    slowest = sorted(cases, key=lambda case: -case.seconds)[:5]
+    print("slowest: " + ", ".join("%s %.3fs" % (case.name, case.seconds) for case in slowest))
+    total = sum(case.seconds for case in cases)
+    print("%d passed, %d failed; %.3fs wall with %d workers, %.3fs of case time (slowest case %.3fs)" %
+          (len(cases) - len(failed), len(failed), elapsed, workers, total, slowest[0].seconds if slowest else 0))
+
+    if args.durations:
+        recorded.update({case.name: case.seconds for case in cases})
+        with open(args.durations, "w") as f:
+            json.dump(recorded, f, indent=2, sort_keys=True)
+            f.write("\n")
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({"wall_s": elapsed, "workers": workers,
+                       "cases": [{"name": case.name, "status": case.status, "seconds": case.seconds,
+                                  "detail": case.detail} for case in cases]}, f, indent=2)
+            f.write("\n")
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()